@@ -1,5 +1,17 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "ldigraph.h"
 
@@ -8,322 +20,7166 @@ struct ldigraph
   size_t n;          // the number of vertices
   size_t *list_size; // the size of each adjacency list
   size_t *list_cap;  // the capacity of each adjacency list
-  size_t **adj;      // the adjacency lists
+  ldigraph_vertex **adj; // the adjacency lists
+  bool frozen;       // true once the lists have been packed into CSR form
+  size_t m;          // the number of edges, once frozen
+  size_t *offset;    // start of each vertex's edges in targets (n + 1
+                     // entries), or NULL once compressed
+  ldigraph_vertex *targets; // the adjacency lists concatenated in vertex order
+  size_t *in_offset; // start of each vertex's in-edges in sources, or NULL
+                     // if in-edges have not been built or are compressed
+  ldigraph_vertex *sources; // the in-edge lists concatenated in vertex order
+  unsigned char *packed;     // the adjacency lists once compressed, each as
+                             // its length and then the gaps between
+                             // neighbors in variable-length bytes, in
+                             // place of offset and targets, or NULL
+  size_t *packed_offset;     // start of each vertex's bytes in packed
+                             // (n + 1 entries)
+  unsigned char *in_packed;  // the in-edge lists the same way, in place of
+                             // in_offset and sources, or NULL
+  size_t *in_packed_offset;  // start of each vertex's bytes in in_packed
+  struct ldigraph_index **index; // membership index for each adjacency list
+                                 // (NULL until some list needs one)
+  ldigraph_adjacency_config config; // when adjacency lists get an index
+  ldigraph_shortest_engine engine;  // how to answer shortest path queries
+  size_t threads;                   // how many threads searches may use
+  int order_state;         // whether the graph is known to be acyclic
+                           // (using enum below)
+  ldigraph_vertex *order;  // the vertices in topological order, if acyclic
+  ldigraph_vertex *position; // the index of each vertex in order
+  ldigraph_vertex *component; // the strongly connected component of each
+                              // vertex, numbered in topological order, or
+                              // NULL until needed
+  ldigraph_vertex *local;     // the index of each vertex among the members
+                              // of its component
+  size_t components;          // the number of components
+  size_t *component_offset;   // start of each component's members
+                              // (components + 1 entries)
+  ldigraph_vertex *members;   // the vertices grouped by component
+  ldigraph_vertex *reach_low;  // for each reachability label and component,
+                               // the start of its interval, or NULL if
+                               // there is no reachability index
+  ldigraph_vertex *reach_post; // the end of each interval, which is the
+                               // component's post-order number
+  size_t *label_offset[2];     // where each vertex's out- and in-labels
+                               // start (n + 1 entries each, using enum
+                               // below), or NULL if there is no 2-hop
+                               // labeling
+  struct ldigraph_label *labels[2]; // the labels concatenated in vertex order
+  void *mapping;               // the file the graph was loaded from, or
+                               // NULL if it was not mapped from a file
+  size_t mapping_size;         // the size of that mapping in bytes
+  size_t landmarks;            // the number of landmarks for ALT searches
+  ldigraph_vertex *landmark_dist; // for each vertex, the distance from each
+                                  // landmark and then to each, or
+                                  // LDIGRAPH_VERTEX_MAX; NULL if there are
+                                  // no landmarks
 };
 
+typedef struct ldigraph_index
+{
+  int kind;        // how the index is stored (using enum below)
+  size_t cap;      // number of hash slots or bitset words
+  size_t count;    // number of targets in the hash table
+  ldigraph_vertex *slots; // open-addressing hash table of targets
+  uint64_t *bits;  // one bit per vertex, set for each target
+} ldigraph_index;
+
+typedef struct
+{
+  const ldigraph_vertex *list; // the next neighbor, or NULL if the list is
+                               // compressed
+  const unsigned char *bytes;  // the next byte of a compressed list
+  size_t last;                 // the neighbor read last from a compressed
+                               // list, or the vertex whose list it is
+} ldigraph_cursor;
+
+typedef struct
+{
+  ldigraph_vertex vertex; // a vertex on the current DFS path
+  size_t next;            // the index of its next out-edge to consider
+  ldigraph_cursor edges;  // where that out-edge is
+} ldigraph_dfs_frame;
+
 typedef struct
 {
   const ldigraph *g; // the graph that was searched
-  int *color; // current status of each vertex (using enum below)
+  size_t cap;        // the number of vertices there is room for
+  uint32_t *stamp;   // the generation in which each vertex was last reached
+  uint32_t epoch;    // the current generation; the entries below are only
+                     // meaningful for vertices stamped with it
+  unsigned char *color; // current status of each vertex (using enum below)
   int *dist; // number of edges on the path that was found to each vertex
              // (not meaningful for DFS)
-  int *pred; // predecessor along the path that was found (won't be needed)
-  // YOU CAN ADD MORE THINGS HERE!
+  ldigraph_vertex *pred; // predecessor along the path that was found
+                         // (won't be needed)
+  ldigraph_vertex *queue; // room for a queue or stack holding every vertex
+  uint64_t *frontier; // one bit per vertex for bottom-up BFS levels
+  uint64_t *next;     // the level being built from frontier
+  ldigraph_dfs_frame *stack; // the path of a DFS, grown as it gets deeper
+  size_t stack_cap;          // the number of frames there is room for
+  size_t finished; // the number of vertices a DFS has finished, which
+                   // are listed in queue in the order they finished
+  size_t vertices_scanned; // vertices whose edges have been examined, over
+                           // all searches since the counts were reset
+  size_t edges_scanned;    // edges examined over the same searches
 } ldigraph_search;
 
+typedef struct
+{
+  ldigraph_vertex vertex; // a vertex that may extend the current path
+  size_t bound;           // the most edges the path could go on for after it
+} ldigraph_path_child;
+
+typedef struct
+{
+  ldigraph_vertex vertex; // a vertex being ordered
+  size_t key;             // what it is ordered by, such as its degree
+} ldigraph_vertex_key;
+
+typedef struct
+{
+  ldigraph_vertex vertex; // a vertex on the current path
+  size_t next;            // the index in children of its next child to try
+  size_t end;             // the index in children just past its last child
+} ldigraph_path_frame;
+
+typedef struct
+{
+  const ldigraph *g;     // the graph being searched
+  size_t words;          // the number of words in each bitset
+  uint64_t *can_reach;   // one bit per vertex, set for those with a path to
+                         // the end of the current query
+  uint64_t *on_path;     // one bit per vertex, set for those on the current path
+  uint32_t *stamp;       // marks for the searches that compute bounds
+  uint32_t epoch;        // the mark for the current bounding search
+  ldigraph_vertex *queue; // room for every vertex for the bounding searches
+  const size_t *in_offset; // the graph's in-edges, or ones built for the
+  const ldigraph_vertex *sources; // search if the graph has none; sources
+                                  // is NULL if the graph's are compressed
+  size_t *own_offset;    // in-edges built for the search, or NULL
+  ldigraph_vertex *own_sources;
+  ldigraph_path_frame *stack; // the current path
+  size_t stack_cap;           // the number of frames there is room for
+  ldigraph_path_child *children; // the children of each vertex on the path,
+                                 // best bound first
+  size_t children_cap;           // the number of children there is room for
+  size_t vertices_scanned; // vertices whose edges have been examined
+  size_t edges_scanned;    // edges examined, including by bounding searches
+  size_t budget;           // vertices the search may still expand, or
+                           // SIZE_MAX for no limit
+  double deadline;         // when the search must stop, in the seconds of
+                           // ldigraph_seconds, or 0 for no limit
+  size_t next_clock;       // the value of edges_scanned at which to look
+                           // at the clock next
+  bool stopped;            // set when the search ran out of budget
+  uint64_t random;         // state for shuffling children in dives, or 0
+                           // to try them most edges out first
+} ldigraph_path_search;
+
+typedef struct
+{
+  ldigraph_vertex *path; // the path to the root of a subtree still to search
+  size_t length;         // the number of vertices on that path
+} ldigraph_path_task;
+
+typedef struct
+{
+  pthread_mutex_t lock;      // protects the other fields
+  ldigraph_path_task *tasks; // the tasks in tasks[head], ..., tasks[tail - 1]
+  size_t head;               // the oldest task, taken by other workers
+  size_t tail;               // just past the newest, taken by the owner
+  size_t cap;                // the number of tasks there is room for
+} ldigraph_path_deque;
+
+typedef struct
+{
+  ldigraph_path_search **states; // the search state of each worker
+  ldigraph_path_deque *deques;   // the tasks each worker has made
+  size_t threads;                // the number of workers
+  size_t to;                     // the end of the query
+  size_t limit;                  // the bound on the length of any path
+  atomic_int *longest;           // the longest path found by any worker
+  atomic_size_t pending;         // tasks made but not yet finished
+  atomic_size_t idle;            // workers waiting for a task
+  atomic_bool failed;            // set if a worker ran out of memory
+  pthread_mutex_t lock;          // protects posted
+  pthread_cond_t wake;           // signalled when posted changes
+  size_t posted;                 // tasks made plus 1 once all are finished
+} ldigraph_path_pool;
+
+typedef struct
+{
+  ldigraph_path_pool *pool; // the search being run
+  size_t id;                // this worker's index in 0, ..., threads-1
+} ldigraph_path_worker;
+
+struct ldigraph_workspace
+{
+  ldigraph_search *fwd; // the search for one-ended queries and the forward
+                        // half of two-ended ones
+  ldigraph_search *bwd; // the backward half of two-ended searches, or NULL
+                        // until one is needed
+};
+
+typedef struct
+{
+  ldigraph_vertex from; // the start of a shortest path query
+  ldigraph_vertex to;   // the end of that query
+  size_t query;         // the position of the query in its batch
+  int bit;              // the bit for from in a multi-source search
+} ldigraph_query_ref;
+
+typedef struct
+{
+  const ldigraph *g;         // the graph being searched
+  atomic_int *dist;          // the distance to each vertex, or -1; a vertex
+                             // belongs to the thread that sets it first
+  ldigraph_vertex *frontier; // the vertices in the current level
+  size_t frontier_size;      // the number of vertices in that level
+  atomic_size_t next_chunk;  // the start of the next part of the frontier
+                             // to be claimed by a thread
+  ldigraph_vertex **local;   // the vertices each thread found for the next
+                             // level
+  size_t *local_size;        // how many vertices each thread found
+  size_t *local_cap;         // room in each thread's buffer
+  size_t *local_start;       // where each thread's vertices go in frontier
+  size_t threads;            // the number of threads
+  int level;                 // the distance of the vertices in frontier
+  atomic_bool failed;        // set if a thread ran out of memory
+  pthread_barrier_t barrier; // keeps the threads on the same level
+  pthread_mutex_t lock;      // protects ready
+  pthread_cond_t start;      // signalled when ready is set
+  bool ready;                // whether the barrier has been set up
+} ldigraph_parallel_bfs;
+
+typedef struct
+{
+  ldigraph_parallel_bfs *bfs; // the search being run
+  size_t id;                  // this thread's index in 0, ..., threads-1
+} ldigraph_parallel_worker;
+
+typedef struct ldigraph_label
+{
+  ldigraph_vertex vertex; // in a label, the rank of a hub; in entries still
+                          // to be added, the vertex whose label gets them
+  ldigraph_vertex dist;   // the distance between the hub and the vertex
+} ldigraph_label;
+
+typedef struct
+{
+  ldigraph_label *entries; // the entries, by increasing hub rank in labels
+  size_t size;             // the number of entries
+  size_t cap;              // the number of entries there is room for
+} ldigraph_label_list;
+
+typedef struct
+{
+  const ldigraph *g;             // the graph being labeled
+  const ldigraph_vertex *order;  // the vertices by rank as hubs
+  ldigraph_label_list *lists[2]; // the out- and in-labels found so far
+  size_t batch;                  // the rank of the first hub in the batch
+                                 // being searched, one hub per thread
+  struct ldigraph_labeling_worker *workers; // the state of each thread
+  size_t threads;                // the number of threads
+  atomic_bool failed;            // set if a thread ran out of memory
+  pthread_barrier_t barrier;     // keeps the threads on the same batch
+  pthread_mutex_t lock;          // protects ready
+  pthread_cond_t start;          // signalled when ready is set
+  bool ready;                    // whether the barrier has been set up
+} ldigraph_labeling;
+
+typedef struct ldigraph_labeling_worker
+{
+  ldigraph_labeling *build;  // the labeling being built
+  size_t id;                 // this thread's index in 0, ..., threads-1
+  ldigraph_vertex *dist;     // the distance to each vertex in the current
+                             // search, or LDIGRAPH_VERTEX_MAX
+  ldigraph_vertex *queue;    // the queue for that search
+  ldigraph_vertex *hub_dist; // the distance between the current hub and
+                             // each hub in its label, by rank, or
+                             // LDIGRAPH_VERTEX_MAX
+  ldigraph_label_list found[2]; // the entries the current hub adds to
+                                // out- and in-labels
+} ldigraph_labeling_worker;
+
+// the sections of a graph file, in the order they appear
+enum
+  {
+    LDIGRAPH_FILE_OFFSET, LDIGRAPH_FILE_TARGETS,
+    LDIGRAPH_FILE_IN_OFFSET, LDIGRAPH_FILE_SOURCES,
+    LDIGRAPH_FILE_COMPONENT, LDIGRAPH_FILE_LOCAL, LDIGRAPH_FILE_COMPONENT_OFFSET, LDIGRAPH_FILE_MEMBERS,
+    LDIGRAPH_FILE_REACH_LOW, LDIGRAPH_FILE_REACH_POST,
+    LDIGRAPH_FILE_SECTIONS
+  };
+
+typedef struct
+{
+  char magic[8];          // LDIGRAPH_FILE_MAGIC
+  uint32_t version;       // LDIGRAPH_FILE_VERSION
+  uint32_t vertex_size;   // the size of ldigraph_vertex where it was saved
+  uint32_t offset_size;   // the size of size_t there
+  uint32_t sections;      // the groups of sections present (using enum
+                          // below)
+  uint32_t reach_labels;  // LDIGRAPH_REACH_LABELS if there is a
+                          // reachability index, otherwise 0
+  uint32_t unused;        // zero
+  uint64_t n;             // the number of vertices
+  uint64_t m;             // the number of edges
+  uint64_t components;    // the number of strongly connected components
+                          // if there is a reachability index, otherwise 0
+  uint64_t pos[LDIGRAPH_FILE_SECTIONS]; // where each section starts, or 0
+                                        // if it is not present
+  uint64_t size;          // the size of the file
+} ldigraph_file_header;
+
+typedef struct
+{
+  char magic[8];        // LDIGRAPH_LABELS_MAGIC
+  uint32_t version;     // LDIGRAPH_LABELS_VERSION
+  uint32_t vertex_size; // the size of ldigraph_vertex where it was saved
+  uint32_t offset_size; // the size of size_t there
+  uint32_t unused;      // zero
+  uint64_t n;           // the number of vertices in the graph
+  uint64_t m;           // the number of edges
+  uint64_t fingerprint; // a hash of the edges
+  uint64_t count[2];    // the number of out- and in-label entries
+} ldigraph_labels_header;
+
+typedef struct
+{
+  size_t *offset;        // start of each vertex's neighbors in list (n + 1
+                         // entries)
+  size_t *split;         // where each vertex's in-neighbors start, after
+                         // its out-neighbors
+  ldigraph_vertex *list; // the neighbors of each vertex in both directions
+} ldigraph_neighborhood;
+
+typedef struct
+{
+  size_t *score;          // how many edges and shared in-neighbors each
+                          // vertex has with the window
+  bool *numbered;         // whether each vertex has its new number yet
+  ldigraph_vertex *first; // the first unnumbered vertex with each score,
+                          // or LDIGRAPH_VERTEX_MAX if there is none
+  size_t cap;             // the number of scores there is room for in first
+  size_t top;             // no unnumbered vertex has a higher score
+  ldigraph_vertex *next;  // the next unnumbered vertex with the same score
+  ldigraph_vertex *prev;  // the previous one, or LDIGRAPH_VERTEX_MAX
+  size_t hub;             // in-neighbors with more out-neighbors than this
+                          // do not count
+} ldigraph_gorder;
+
 enum {LDIGRAPH_UNSEEN, LDIGRAPH_PROCESSING, LDIGRAPH_DONE};
 
+enum {LDIGRAPH_INDEX_NONE, LDIGRAPH_INDEX_HASH, LDIGRAPH_INDEX_BITSET};
+
+enum {LDIGRAPH_ORDER_UNKNOWN, LDIGRAPH_ORDER_ACYCLIC, LDIGRAPH_ORDER_CYCLIC};
+
+enum {LDIGRAPH_LABEL_OUT, LDIGRAPH_LABEL_IN};
+
+enum {LDIGRAPH_FILE_EDGES = 1, LDIGRAPH_FILE_IN_EDGES = 2, LDIGRAPH_FILE_REACHABILITY = 4};
+
 #define LDIGRAPH_ADJ_LIST_INITIAL_CAPACITY 4
+#define LDIGRAPH_INDEX_DEFAULT_THRESHOLD 32
+#define LDIGRAPH_INDEX_DEFAULT_BITSET_DENSITY (1.0 / 64)
+#define LDIGRAPH_INDEX_EMPTY_SLOT LDIGRAPH_VERTEX_MAX
+
+// direction-optimizing BFS goes bottom-up once the frontier has more than
+// 1/ALPHA of the edges out of unexplored vertices, and back to top-down
+// once the frontier is shrinking and has fewer than 1/BETA of the vertices
+#define LDIGRAPH_BFS_ALPHA 15
+#define LDIGRAPH_BFS_BETA 18
+
+// the number of sources a multi-source BFS advances at once (the bits
+// in one word of the per-vertex masks)
+#define LDIGRAPH_MSBFS_WIDTH 64
+
+// the number of frontier vertices a thread claims at a time in
+// parallel BFS, and the initial size of its buffer for the next level
+#define LDIGRAPH_PARALLEL_CHUNK 256
+
+// the number of frames first allocated for a DFS stack
+#define LDIGRAPH_DFS_INITIAL_STACK 64
+
+// how far below the root of its task a parallel longest path search will
+// hand subtrees to idle workers
+#define LDIGRAPH_PATH_SPLIT_DEPTH 4
+
+// the number of interval labels each component gets in a reachability
+// index; each comes from a DFS of the condensation in a different order
+#define LDIGRAPH_REACH_LABELS 2
+
+// the version of the graph file format written by ldigraph_save, and
+// the boundary each of its sections starts on
+#define LDIGRAPH_FILE_VERSION 1
+#define LDIGRAPH_FILE_ALIGNMENT 64
+
+// the number of decoded neighbors written to a graph file at a time
+#define LDIGRAPH_FILE_BUFFER 1024
+
+// the number of most recently numbered vertices a Gorder ordering keeps
+// each new vertex close to
+#define LDIGRAPH_GORDER_WINDOW 5
+
+// the number of entries first allocated for a label while building a
+// 2-hop labeling
+#define LDIGRAPH_LABEL_INITIAL_CAPACITY 4
+
+// identifies saved 2-hop labelings and their layout
+#define LDIGRAPH_LABELS_MAGIC "LDGLABEL"
+#define LDIGRAPH_LABELS_VERSION 1
+
+// the number of depth-first dives that seed a budgeted longest path
+// search, which share the first half of the budget
+#define LDIGRAPH_APPROX_RESTARTS 8
+
+// how many edges a budgeted search examines, counting those of its
+// bounding searches, between looks at the clock
+#define LDIGRAPH_APPROX_CLOCK_INTERVAL 65536
+
+// the largest strongly connected component whose longest paths are found
+// with tables over all subsets of its vertices (2^k words of memory and
+// up to O(2^k k^3) time) rather than by search
+#define LDIGRAPH_SUBSET_DP_LIMIT 16
+
+// graphs with more vertices than LDIGRAPH_GROUP_THRESHOLD are built from
+// edge lists by first grouping the edges into LDIGRAPH_GROUPS ranges of
+// sources, each small enough that placing its edges stays in cache
+#define LDIGRAPH_GROUP_THRESHOLD (1 << 18)
+#define LDIGRAPH_GROUPS 1024
+
+// repeated edges in adjacency lists no longer than this are found by
+// scanning the edges kept so far rather than by marking vertices
+#define LDIGRAPH_REPEAT_SCAN_LIMIT 32
+
+// each thread's workspace for the query functions that do not take one,
+// kept between queries and destroyed when the thread exits
+static pthread_once_t ldigraph_thread_workspace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ldigraph_thread_workspace_key;
+static bool ldigraph_thread_workspace_ready = false;
 
 // YOU MAY CHANGE THE SIGNATURES OF ANY OF THE FUNCTIONS BELOW AS YOU SEE FIT
 
 /**
- * Returns the result of running breadth-first search on the given
- * graph starting with the given vertex.  When the search arrives
- * at a vertex, its neighbors are considered in the order the
- * corresponding edges were added to the graph.
- * It is the caller's responsibility to destroy to result.
+ * Runs breadth-first search on the given graph starting with the given
+ * vertex, leaving the result in the given search.  When the search
+ * arrives at a vertex, its neighbors are considered in the order the
+ * corresponding edges were added to the graph.  If targets are given,
+ * the search stops as soon as all of them have been reached, since
+ * their distances are final by then; other vertices may be left
+ * unreached.
  *
  * @param g a pointer to a directed graph, non-NULL
+ * @param s a search with room for the vertices of g
  * @param from the index of a vertex in the given graph
- * @return the result of the search
+ * @param targets an array of vertex indices in g, or NULL to search
+ * everything reachable from from
+ * @param target_count the number of targets
  */
-static ldigraph_search *ldigraph_bfs(const ldigraph *g, size_t from);
+static void ldigraph_bfs(const ldigraph *g, ldigraph_search *s, size_t from, const size_t *targets, size_t target_count);
 
 
 /**
- * Returns the result of running depth-first search on the given
- * graph starting with the given vertex.  When the search arrives
- * at a vertex, its neighbors are considered in the order the
- * corresponding edges were added to the graph.
- * It is the caller's responsibility to destroy to result.
+ * Runs depth-first search on the given graph starting with the given
+ * vertex, leaving the result in the given search.  When the search
+ * arrives at a vertex, its neighbors are considered in the order the
+ * corresponding edges were added to the graph.  The vertices reached
+ * are left in the search's queue in the order they were finished.
  *
  * @param g a pointer to a directed graph, non-NULL
+ * @param s a search with room for the vertices of g
  * @param from the index of a vertex in the given graph
- * @return the result of the search
+ * @return true if successful, false if there was not enough memory
+ * for the search's stack
  */
-static ldigraph_search *ldigraph_dfs(const ldigraph *g, size_t from);
+static bool ldigraph_dfs(const ldigraph *g, ldigraph_search *s, size_t from);
 
 
 /**
- * Visits the given vertex in the given search of the given graph.
+ * Visits the given vertex and everything newly reachable from it in the
+ * given search of the given graph.  The current path is kept in the
+ * search's stack of frames rather than on the call stack, so the depth
+ * of the search is limited only by memory.
  *
  * @param g a pointer to a directed graph
  * @param s a search in that graph
- * @param curr a vertex in that graph
+ * @param start a vertex in that graph that has already been reached
+ * @return true if successful, false if there was not enough memory
+ * for the search's stack
  */
-static void ldigraph_dfs_visit(const ldigraph* g, ldigraph_search *s, size_t curr);
+static bool ldigraph_dfs_visit(const ldigraph* g, ldigraph_search *s, size_t start);
 
 
 /**
- * Resizes the adjacency list for the given vertex in the given graph.
- * 
- * @param g a pointer to a directed graph
- * @param from the index of a vertex in that graph
+ * Makes room for at least the given number of frames on the given
+ * search's DFS stack, keeping the frames already there.
+ *
+ * @param s a pointer to a search, non-NULL
+ * @param frames the number of frames needed
+ * @return true if and only if there is now enough room
  */
-static void ldigraph_list_embiggen(ldigraph *g, size_t from);
+static bool ldigraph_search_reserve_stack(ldigraph_search *s, size_t frames);
 
 
 /**
- * Prepares a search result for the given graph starting from the given
- * vertex.  It is the responsibility of the caller to destroy the result.
+ * Initializes the fields shared by all ways of creating a graph: the
+ * number of vertices, the missing in-edges and indices, and the default
+ * settings.
  *
- * @param g a pointer to a directed graph
- * @return a pointer to a search result
+ * @param g a pointer to a graph being created, non-NULL
+ * @param n the number of vertices in that graph
+ */
+static void ldigraph_init_common(ldigraph *g, size_t n);
+
+
+/**
+ * Returns the calling thread's workspace for the query functions that
+ * do not take one, creating it with room for the given number of
+ * vertices if the thread has none yet.
+ *
+ * @param n the number of vertices to make room for
+ * @return a pointer to the thread's workspace, or NULL if there is not
+ * enough memory
+ */
+static ldigraph_workspace *ldigraph_thread_workspace(size_t n);
+
+
+/**
+ * Creates the key under which each thread's workspace is kept.
+ */
+static void ldigraph_thread_workspace_init(void);
+
+
+/**
+ * Destroys a thread's workspace when the thread exits.
+ *
+ * @param ws a pointer to a workspace
+ */
+static void ldigraph_thread_workspace_release(void *ws);
+
+
+/**
+ * Determines whether the given graph is acyclic and, if it is, caches a
+ * topological order of its vertices on it.  Nothing is done if that is
+ * already known.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_topological_order(ldigraph *g);
+
+
+/**
+ * Determines whether the given graph's reachability index shows that
+ * there is no path from the given vertex to the given vertex.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param from the index of a vertex in the given graph
+ * @param to the index of a vertex in the given graph
+ * @return true if there is certainly no path, false if there may be
+ * one or the graph has no reachability index
+ */
+static bool ldigraph_reach_excluded(const ldigraph *g, size_t from, size_t to);
+
+
+/**
+ * Fills in the positions of the sections of a graph file and the size
+ * of the file from the sizes and sections given in its header.
+ *
+ * @param header a pointer to a header, non-NULL
  */
-static ldigraph_search *ldigraph_search_create(const ldigraph *g);
+static void ldigraph_file_layout(ldigraph_file_header *header);
 
 
 /**
- * Initializes a search result that has its associated graph set and
- * has space allocated for its arrays.
+ * Returns the group of sections the given section of a graph file
+ * belongs to, all of which are present or none.
+ *
+ * @param section a section of a graph file
+ * @return LDIGRAPH_FILE_EDGES, LDIGRAPH_FILE_IN_EDGES, or
+ * LDIGRAPH_FILE_REACHABILITY
+ */
+static uint32_t ldigraph_file_section_group(int section);
+
+
+/**
+ * Returns the size in bytes of the given section of a graph file with
+ * the given header.
+ *
+ * @param header a pointer to a header, non-NULL
+ * @param section a section of a graph file
+ * @return the size of the section
+ */
+static size_t ldigraph_file_section_size(const ldigraph_file_header *header, int section);
+
+
+/**
+ * Returns the first position in a graph file at or after the given one
+ * where a section may start.
+ *
+ * @param pos a position in a file
+ * @return the position of the next section
+ */
+static size_t ldigraph_file_align(size_t pos);
+
+
+/**
+ * Writes the given data to the given file and advances the given
+ * position past it.
+ *
+ * @param out a file open for writing, non-NULL
+ * @param data a pointer to the data, non-NULL if size > 0
+ * @param size the number of bytes to write
+ * @param pos a pointer to the position in the file, non-NULL
+ * @return true if successful, false if there was a write error
+ */
+static bool ldigraph_file_write(FILE *out, const void *data, size_t size, size_t *pos);
+
+
+/**
+ * Writes zero bytes to the given file up to the given position.
+ *
+ * @param out a file open for writing, non-NULL
+ * @param target the position to pad to
+ * @param pos a pointer to the position in the file, non-NULL
+ * @return true if successful, false if there was a write error
+ */
+static bool ldigraph_file_pad(FILE *out, size_t target, size_t *pos);
+
+
+/**
+ * Determines whether the given memory belongs to the file the given
+ * graph was mapped from, and so must not be freed.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param p a pointer
+ * @return true if p points into the graph's mapping
+ */
+static bool ldigraph_is_mapped(const ldigraph *g, const void *p);
+
+
+/**
+ * Creates a frozen graph that uses the given graph file in place.  See
+ * ldigraph_map and ldigraph_map_checked.
+ *
+ * @param filename the name of a file, non-NULL
+ * @param check true to check every section before using the file
+ * @return a pointer to the new graph, or NULL if the file could not be
+ * mapped or is not a valid graph file for this machine
+ */
+static ldigraph *ldigraph_map_file(const char *filename, bool check);
+
+
+/**
+ * Checks the sections of a mapped graph file whose header and section
+ * ends have been checked already: that the offsets never decrease, that
+ * every target, source, and member is a vertex and no edge is a loop,
+ * that each vertex has as many in-edges as edges to it, that the
+ * components list each vertex once, and that edges never go to a lower
+ * component.
+ *
+ * @param header a pointer to the file's header, non-NULL
+ * @param bytes a pointer to the start of the file, non-NULL
+ * @return true if the file is valid, false if it is not or there was not
+ * enough memory to tell
+ */
+static bool ldigraph_file_check(const ldigraph_file_header *header, const char *bytes);
+
+
+/**
+ * Runs the threads that build a 2-hop labeling.  The hubs are taken in
+ * batches of one per thread; each thread runs the pruned searches from
+ * its hub, and then one thread adds what they found to the labels.
+ *
+ * @param arg a pointer to a ldigraph_labeling_worker, non-NULL
+ * @return NULL
+ */
+static void *ldigraph_labeling_worker_run(void *arg);
+
+
+/**
+ * Runs a pruned BFS from the hub with the given rank, recording entries
+ * for the given kind of label in the worker's found list.  A forward
+ * search finds in-label entries and a backward one finds out-label
+ * entries.  The search does not go past vertices whose distance is
+ * already covered by hubs of lower rank.
+ *
+ * @param worker a pointer to the state of a labeling thread, non-NULL
+ * @param rank the rank of a hub
+ * @param kind LDIGRAPH_LABEL_OUT or LDIGRAPH_LABEL_IN
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_labeling_bfs(ldigraph_labeling_worker *worker, size_t rank, int kind);
+
+
+/**
+ * Adds an entry to the end of the given list of label entries.
+ *
+ * @param list a pointer to a list, non-NULL
+ * @param vertex the vertex field of the entry
+ * @param dist the distance field of the entry
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_label_list_add(ldigraph_label_list *list, size_t vertex, size_t dist);
+
+
+/**
+ * Returns the distance from the given vertex to the given vertex
+ * according to the given graph's 2-hop labeling.
+ *
+ * @param g a pointer to a directed graph with a labeling, non-NULL
+ * @param from the index of a vertex in the given graph
+ * @param to the index of a vertex in the given graph
+ * @return the distance, or -1 if there is no path
+ */
+static int ldigraph_labels_distance(const ldigraph *g, size_t from, size_t to);
+
+
+/**
+ * Fills in the header for saving the given graph's 2-hop labeling, or
+ * for checking that a saved one fits the graph.
+ *
+ * @param g a pointer to a frozen directed graph, non-NULL
+ * @param header a pointer to the header to fill in, non-NULL
+ */
+static void ldigraph_labels_header_init(const ldigraph *g, ldigraph_labels_header *header);
+
+
+/**
+ * Discards the given graph's 2-hop labeling, if any.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ */
+static void ldigraph_labels_clear(ldigraph *g);
+
+
+/**
+ * Finds the distance from or to the given vertex for every vertex in
+ * the given graph with breadth-first search.
+ *
+ * @param g a pointer to a directed graph with in-edges, non-NULL
+ * @param from the index of a vertex in the given graph
+ * @param forward true to find distances from from, false to find
+ * distances to it
+ * @param dist an array where the distance for vertex v goes in
+ * dist[v * stride], or LDIGRAPH_VERTEX_MAX for no path
+ * @param stride the spacing of the distances in dist
+ * @param queue an array with room for every vertex
+ */
+static void ldigraph_landmark_bfs(const ldigraph *g, size_t from, bool forward, ldigraph_vertex *dist, size_t stride, ldigraph_vertex *queue);
+
+
+/**
+ * Returns a lower bound on the distance from the given vertex to the
+ * vertex with the given landmark distances, from the triangle
+ * inequality over the given graph's landmarks.
+ *
+ * @param g a pointer to a directed graph with landmarks, non-NULL
+ * @param v the index of a vertex in the given graph
+ * @param target the landmark distances of the end vertex
+ * @return the lower bound, or LDIGRAPH_VERTEX_MAX if the landmarks show
+ * there is no path
+ */
+static size_t ldigraph_landmark_bound(const ldigraph *g, size_t v, const ldigraph_vertex *target);
+
+
+/**
+ * Returns the length of the shortest path between the given vertices
+ * using A* search guided by the given graph's landmarks.
+ *
+ * @param g a pointer to a directed graph with landmarks, non-NULL
+ * @param s a pointer to a search result with room for the graph's
+ * vertices, non-NULL
+ * @param from the index of a vertex in the given graph
+ * @param to the index of a vertex in the given graph
+ * @return the length of the shortest path, or -1 if there is none or
+ * there was not enough memory
+ */
+static int ldigraph_alt_search(const ldigraph *g, ldigraph_search *s, size_t from, size_t to);
+
+
+/**
+ * Adds the given vertex to the binary heap kept in the given search's
+ * stack, whose frames hold a vertex and its key.  Vertices with smaller
+ * keys come out first, and among equal keys those farther from the
+ * start.  The vertex must have been reached in the search.
  *
  * @param s a pointer to a search result, non-NULL
+ * @param size a pointer to the number of entries in the heap, non-NULL
+ * @param v the index of a vertex
+ * @param key the key of the vertex
+ * @return true if successful, false if there was not enough memory
  */
-static void ldigraph_search_init(ldigraph_search *s);
+static bool ldigraph_heap_push(ldigraph_search *s, size_t *size, size_t v, size_t key);
 
 
 /**
- * Destroys the given search result.
+ * Removes the first vertex from the binary heap kept in the given
+ * search's stack.
  *
  * @param s a pointer to a search result, non-NULL
+ * @param size a pointer to the number of entries in the heap, positive
+ * @return the vertex removed
  */
-static void ldigraph_search_destroy(ldigraph_search *s);
+static size_t ldigraph_heap_pop(ldigraph_search *s, size_t *size);
+
+
+/**
+ * Determines whether the given vertex with the given key comes out of
+ * a heap before the given entry.
+ *
+ * @param s a pointer to a search result, non-NULL
+ * @param v the index of a vertex reached in the search
+ * @param key the key of v
+ * @param entry a pointer to a heap entry, non-NULL
+ * @return true if v comes first
+ */
+static inline bool ldigraph_heap_before(const ldigraph_search *s, size_t v, size_t key, const ldigraph_dfs_frame *entry);
+
+
+/**
+ * Returns the length of the longest path from the given vertex to the
+ * given vertex in the given acyclic graph, or -1 if there is no path.
+ * Path lengths are relaxed in topological order over only the vertices
+ * between from and to in the graph's cached order.
+ *
+ * @param g a pointer to an acyclic directed graph with a cached
+ * topological order, non-NULL
+ * @param s a search with room for the vertices of g
+ * @param from the index of a vertex in the given graph
+ * @param to the index of a vertex in the given graph
+ * @return the length of the longest path, or -1
+ */
+static int ldigraph_longest_path_dag(const ldigraph *g, ldigraph_search *s, size_t from, size_t to);
+
+
+/**
+ * Returns the length of the longest path to the given vertex from the
+ * start of the DFS just run in the given search if no cycle can be
+ * reached from that start, using the order in which the DFS finished
+ * the vertices it reached.  That order reversed is topological unless
+ * there is a cycle, which shows up as an edge against it.  Takes time
+ * linear in the size of the part of the graph reached.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param s a search that has just run ldigraph_dfs on g
+ * @param to the index of a vertex reached by that search
+ * @param acyclic a pointer to a location to store whether no cycle can
+ * be reached from the start
+ * @return the length of the longest path if no cycle can be reached,
+ * or -1
+ */
+static int ldigraph_longest_path_reached(const ldigraph *g, ldigraph_search *s, size_t to, bool *acyclic);
+
+
+/**
+ * Finds the strongly connected components of the given graph and caches
+ * them on it, numbered so that every edge between components goes from
+ * a lower number to a higher one.  Nothing is done if they are already
+ * known.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_components_build(ldigraph *g);
+
+
+/**
+ * Returns the length of the longest simple path from the given vertex to
+ * the given vertex in the given graph, whose strongly connected
+ * components have been found.  Path lengths are carried through the
+ * components between those of from and to in topological order.  Within
+ * a component the longest path from each vertex where a path arrives to
+ * each vertex of the component is found with ldigraph_subset_dp if the
+ * component is small enough, and with a search limited to the component
+ * otherwise.  Entry vertices reached by paths of the same length share
+ * one table, so a component of k vertices takes O(2^k k^2) time for each
+ * distinct length, and O(2^k k^3) at worst.
+ *
+ * @param g a pointer to a directed graph with its components cached,
+ * non-NULL
+ * @param s a search for counting the work done
+ * @param from the index of a vertex in the given graph
+ * @param to the index of a vertex in the given graph
+ * @return the length of the longest simple path, or -1 if there is no
+ * path or not enough memory
+ */
+static int ldigraph_longest_path_components(const ldigraph *g, ldigraph_search *s, size_t from, size_t to);
+
+
+/**
+ * Finds the lengths of the longest simple paths from any of the given
+ * vertices to each vertex in a graph with at most 32 vertices, given as
+ * adjacency bitmasks, by working out where a path through each subset
+ * of the vertices can end.  This takes O(2^k k^2) time.
+ *
+ * @param k the number of vertices
+ * @param adjacent for each vertex, the set of vertices it has edges to
+ * @param entries the set of vertices paths may start at
+ * @param dp an array with room for 2^k sets
+ * @param inner an array of k lengths to fill in, with -1 for vertices
+ * that can't be reached
+ */
+static void ldigraph_subset_dp(size_t k, const uint32_t *adjacent, uint32_t entries, uint32_t *dp, int *inner);
+
+
+/**
+ * Creates the state for branch-and-bound searches for longest simple
+ * paths in the given graph.  If the graph has no in-edges, the search
+ * uses the ones built by the given search, or builds its own.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param share a pointer to a search of the same graph that will
+ * outlive the new one, or NULL
+ * @return a pointer to the new search state, or NULL if there was not
+ * enough memory
+ */
+static ldigraph_path_search *ldigraph_path_search_create(const ldigraph *g, const ldigraph_path_search *share);
+
+
+/**
+ * Returns the length of the longest simple path from the given vertex to
+ * the given vertex with a branch-and-bound search, using only the
+ * allowed vertices if a set of them is given.  Vertices that cannot
+ * reach to are never entered.  The rest of a path through a vertex is
+ * bounded by the number of unvisited vertices reachable from it, the
+ * children of each vertex are tried largest bound first, and branches
+ * whose bound can't beat the best path found so far are dropped.  The
+ * search stops as soon as a path meets the bound for the whole query.
+ *
+ * @param ps a pointer to a search state, non-NULL
+ * @param from the index of a vertex in the searched graph
+ * @param to the index of a vertex in the searched graph
+ * @param allowed one bit per vertex, set for those the path may use
+ * (including from and to), or NULL to allow all vertices
+ * @return the length of the longest simple path, or -1 if there is no
+ * path or not enough memory
+ */
+static int ldigraph_path_search_run(ldigraph_path_search *ps, size_t from, size_t to, const uint64_t *allowed);
+
+
+/**
+ * Finds the vertices that can reach the given vertex, using only the
+ * allowed ones if a set of them is given, and the bound on the length of
+ * any simple path between the given vertices.
+ *
+ * @param ps a pointer to a search state, non-NULL
+ * @param from the index of a vertex in the searched graph
+ * @param to the index of a vertex in the searched graph, not from
+ * @param allowed one bit per vertex, set for those the path may use
+ * (including from and to), or NULL to allow all vertices
+ * @param limit a pointer to a location to store the bound
+ * @return true if there may be a path from from to to, false if not
+ */
+static bool ldigraph_path_search_prepare(ldigraph_path_search *ps, size_t from, size_t to, const uint64_t *allowed, size_t *limit);
+
+
+/**
+ * Returns the current time in seconds from some fixed point.
+ *
+ * @return the time from a monotonic clock
+ */
+static double ldigraph_seconds(void);
+
+
+/**
+ * Searches the subtree of simple paths that start with the given prefix,
+ * recording the length of the longest one to the given vertex found.  The
+ * vertices that can reach to must already be known.  When given a pool
+ * of workers, children near the root of the subtree are handed to it as
+ * new tasks while other workers are idle.
+ *
+ * @param ps a pointer to a search state, non-NULL
+ * @param prefix the vertices on the path to the root of the subtree
+ * @param length the number of vertices in prefix, at least 1
+ * @param to the end of the query
+ * @param limit the bound on the length of any path to to
+ * @param longest the longest path found so far, updated atomically
+ * @param pool a pointer to the pool of workers, or NULL
+ * @param id the index of the calling worker in the pool
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_path_search_extend(ldigraph_path_search *ps, const ldigraph_vertex *prefix, size_t length, size_t to, size_t limit, atomic_int *longest, ldigraph_path_pool *pool, size_t id);
+
+
+/**
+ * Finds a simple path from the given vertex to the given vertex with a
+ * depth-first search that marks each vertex once and tries to last.
+ * Children are tried most edges out first, or in a random order if the
+ * search state has a random seed.  The search stops when it first
+ * arrives at to, so it takes linear time at most and the path is only
+ * a lower bound.  The vertices that can reach to must already be known.
+ *
+ * @param ps a pointer to a search state, non-NULL
+ * @param from the index of a vertex that can reach to
+ * @param to the end of the query, not equal to from
+ * @param length a pointer to a location to store the length of the path
+ * found, or -1 if the search ran out of budget first
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_path_search_dive(ldigraph_path_search *ps, size_t from, size_t to, int *length);
+
+
+/**
+ * Runs a longest path search with as many workers as the graph allows
+ * threads.  Each worker has a deque of tasks; a worker takes its newest
+ * task and, when it has none, steals the oldest task of another.  Busy
+ * workers split off subtrees near the root of their tasks while some
+ * worker is idle, and all prune against one longest length shared
+ * through an atomic, so the answer is the same as with one thread.
+ *
+ * @param ps a pointer to a search state with the vertices that can reach
+ * to known, non-NULL
+ * @param from the start of the query
+ * @param to the end of the query
+ * @param limit the bound on the length of any path to to
+ * @param longest where to record the length of the longest path
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_path_search_parallel(ldigraph_path_search *ps, size_t from, size_t to, size_t limit, atomic_int *longest);
+
+
+/**
+ * Runs one worker of a parallel longest path search until every task is
+ * finished.
+ *
+ * @param arg a pointer to an ldigraph_path_worker
+ * @return NULL
+ */
+static void *ldigraph_path_worker_run(void *arg);
+
+
+/**
+ * Hands the subtree of paths that continue the given path with the given
+ * vertex to the given pool as a new task of the given worker.
+ *
+ * @param pool a pointer to a pool of workers, non-NULL
+ * @param id the index of the worker
+ * @param prefix the vertices on the path to the root of that worker's task
+ * @param base the number of those vertices before the root
+ * @param stack the path from the root of the task
+ * @param depth the number of frames on that path
+ * @param next the vertex to continue the path with
+ * @return true if the task was made, false if there was not enough memory
+ */
+static bool ldigraph_path_pool_split(ldigraph_path_pool *pool, size_t id, const ldigraph_vertex *prefix, size_t base, const ldigraph_path_frame *stack, size_t depth, size_t next);
+
+
+/**
+ * Wakes workers of the given pool that are waiting for a task.
+ *
+ * @param pool a pointer to a pool of workers, non-NULL
+ * @param all true to wake every worker, false to wake one
+ */
+static void ldigraph_path_pool_wake(ldigraph_path_pool *pool, bool all);
+
+
+/**
+ * Adds a task to the newest end of the given deque, which takes ownership
+ * of the given path.
+ *
+ * @param d a pointer to a deque, non-NULL
+ * @param path an array of vertices allocated with malloc
+ * @param length the number of vertices in path
+ * @return true if the task was added, false if there was not enough memory
+ */
+static bool ldigraph_path_deque_push(ldigraph_path_deque *d, ldigraph_vertex *path, size_t length);
+
+
+/**
+ * Removes a task from the given deque.
+ *
+ * @param d a pointer to a deque, non-NULL
+ * @param task a pointer to a location to store the task
+ * @param newest true to take the newest task, false for the oldest
+ * @return true if there was a task, false if the deque was empty
+ */
+static bool ldigraph_path_deque_pop(ldigraph_path_deque *d, ldigraph_path_task *task, bool newest);
+
+
+/**
+ * Atomically raises the given value to at least the given one.
+ *
+ * @param x a pointer to an atomic integer, non-NULL
+ * @param value an integer
+ */
+static void ldigraph_atomic_max(atomic_int *x, int value);
+
+
+/**
+ * Determines how many more edges a simple path could have after reaching
+ * the given vertex without revisiting the current path, by counting the
+ * unvisited vertices that can reach the end of the query and that are
+ * reachable from the given one without going through the end.
+ *
+ * @param ps a pointer to a search state, non-NULL
+ * @param v a vertex not on the current path
+ * @param to the end of the query
+ * @param bound a pointer to a location to store the bound
+ * @return true if a path from v can still reach to, false otherwise
+ */
+static bool ldigraph_path_search_bound(ldigraph_path_search *ps, size_t v, size_t to, size_t *bound);
+
+
+/**
+ * Determines whether the given search has passed its deadline, looking
+ * at the clock only once every LDIGRAPH_APPROX_CLOCK_INTERVAL edges
+ * examined.
+ *
+ * @param ps a pointer to a search state, non-NULL
+ * @return true if the search has a deadline and it has passed
+ */
+static inline bool ldigraph_path_search_late(ldigraph_path_search *ps);
+
+
+/**
+ * Compares two children in a branch-and-bound search so that ones with
+ * larger bounds come first.
+ *
+ * @param a a pointer to a child, non-NULL
+ * @param b a pointer to a child, non-NULL
+ * @return a negative number, zero, or a positive number as the first
+ * child should be tried before, with, or after the second
+ */
+static int ldigraph_path_child_compare(const void *a, const void *b);
+
+
+/**
+ * Destroys the given branch-and-bound search state.
+ *
+ * @param ps a pointer to a search state, or NULL
+ */
+static void ldigraph_path_search_destroy(ldigraph_path_search *ps);
+
+
+/**
+ * Runs direction-optimizing breadth-first search on the given graph
+ * starting with the given vertex, leaving the result in the given
+ * search.  Levels with few outgoing edges are expanded top-down from a
+ * queue, as in ldigraph_bfs.  Levels whose frontier is large are built
+ * bottom-up: each unseen vertex scans its in-edges for one from a vertex
+ * in the frontier bitmap.  Distances agree with ldigraph_bfs, though
+ * predecessors may differ.  The graph must have had its in-edges built.
+ *
+ * @param g a pointer to a directed graph with in-edges
+ * @param s a search with room for the vertices of g
+ * @param from the index of a vertex in the given graph
+ * @param target the index of a vertex to stop at once reached, or
+ * LDIGRAPH_VERTEX_MAX to search everything reachable from from
+ */
+static void ldigraph_bfs_direction_optimizing(const ldigraph *g, ldigraph_search *s, size_t from, size_t target);
+
+
+/**
+ * Builds the next level of a direction-optimizing BFS bottom-up: every
+ * unseen vertex with an in-edge from a vertex in the frontier bitmap
+ * of the given search is reached and added to its next bitmap.
+ *
+ * @param g a pointer to a directed graph with in-edges
+ * @param s a search in that graph
+ * @param level the distance of the vertices in the frontier
+ * @param target a vertex to stop at once reached, or LDIGRAPH_VERTEX_MAX
+ * @param edges_unexplored a pointer to the number of edges out of unseen
+ * vertices, updated as vertices are reached
+ * @return the number of vertices reached
+ */
+static size_t ldigraph_bfs_bottom_up_step(const ldigraph *g, ldigraph_search *s, int level, size_t target, size_t *edges_unexplored);
+
+
+/**
+ * Answers the given shortest path queries, which are sorted by start
+ * vertex and have at most LDIGRAPH_MSBFS_WIDTH distinct start vertices
+ * numbered by their bit fields, with one breadth-first sweep that
+ * advances a search from every start vertex at once.  Each vertex keeps
+ * one bit per search in each of three masks: the searches that have
+ * seen it, the ones that have it in their frontier, and the ones that
+ * will have it in their next frontier.  Vertices with a nonzero
+ * frontier mask are also kept in a list so each level only costs as
+ * much as the edges it expands.  The sweep stops once every query is
+ * answered.
+ *
+ * @param g a pointer to a directed graph
+ * @param refs an array of queries
+ * @param ref_count the number of queries
+ * @param lengths an array to store the answer to each query in, indexed
+ * by the query fields
+ * @param masks an array with room for 3 * ldigraph_size(g) masks
+ * @param lists an array with room for 2 * ldigraph_size(g) vertices
+ * @param s a search whose work counts are updated
+ */
+static void ldigraph_multi_source_bfs(const ldigraph *g, const ldigraph_query_ref *refs, size_t ref_count, int *lengths, uint64_t *masks, ldigraph_vertex *lists, ldigraph_search *s);
+
+
+/**
+ * Runs one thread's share of a level-synchronous parallel BFS.  On each
+ * level the threads claim chunks of the frontier, expand them, and keep
+ * the vertices they claim with a compare-and-swap on the distance array
+ * in their own buffers.  After a barrier the first thread works out
+ * where each buffer goes, and after another all threads copy their
+ * buffers into the frontier for the next level.
+ *
+ * @param arg a pointer to an ldigraph_parallel_worker
+ * @return NULL
+ */
+static void *ldigraph_parallel_bfs_worker(void *arg);
+
+
+/**
+ * Compares two shortest path queries by start vertex and then by
+ * position in their batch.
+ *
+ * @param a a pointer to an ldigraph_query_ref
+ * @param b a pointer to an ldigraph_query_ref
+ * @return a negative number, zero, or a positive number as a goes
+ * before, with, or after b
+ */
+static int ldigraph_query_ref_compare(const void *a, const void *b);
+
+
+/**
+ * Sets the given cursor to the start of the adjacency list of the given
+ * vertex in the given graph and returns the length of the list.  Works
+ * for the per-vertex lists of a graph under construction and for the
+ * packed and compressed lists of a frozen graph, with neighbors in the
+ * order the edges were added unless the lists were sorted when they were
+ * compressed.
+ *
+ * @param g a pointer to a directed graph
+ * @param v the index of a vertex in that graph
+ * @param c a pointer to a cursor, non-NULL
+ * @return the out-degree of v
+ */
+static inline size_t ldigraph_out_edges(const ldigraph *g, size_t v, ldigraph_cursor *c);
+
+
+/**
+ * Sets the given cursor to the start of the list of vertices with an
+ * edge to the given vertex in the given graph and returns the length of
+ * the list.  The graph must have had its in-edges built.
+ *
+ * @param g a pointer to a directed graph with in-edges
+ * @param v the index of a vertex in that graph
+ * @param c a pointer to a cursor, non-NULL
+ * @return the in-degree of v
+ */
+static inline size_t ldigraph_in_edges(const ldigraph *g, size_t v, ldigraph_cursor *c);
+
+
+/**
+ * Returns the out-degree of the given vertex in the given graph.
+ *
+ * @param g a pointer to a directed graph
+ * @param v the index of a vertex in that graph
+ * @return the out-degree of v
+ */
+static inline size_t ldigraph_out_degree(const ldigraph *g, size_t v);
+
+
+/**
+ * Returns the in-degree of the given vertex in the given graph.  The
+ * graph must have had its in-edges built.
+ *
+ * @param g a pointer to a directed graph with in-edges
+ * @param v the index of a vertex in that graph
+ * @return the in-degree of v
+ */
+static inline size_t ldigraph_in_degree(const ldigraph *g, size_t v);
+
+
+/**
+ * Determines whether the given graph has had its in-edges built.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @return true if and only if the graph has in-edges
+ */
+static inline bool ldigraph_has_in_edges(const ldigraph *g);
+
+
+/**
+ * Reads an unsigned integer stored in variable-length bytes, seven bits
+ * to a byte with the low bits first and the high bit set on every byte
+ * but the last.
+ *
+ * @param bytes a pointer to the first byte, which is advanced past the
+ * last
+ * @return the integer
+ */
+static inline uint64_t ldigraph_varint_read(const unsigned char **bytes);
+
+
+/**
+ * Sets the given cursor to the start of a list of neighbors of the given
+ * vertex that is either an array or compressed bytes.
+ *
+ * @param c a pointer to a cursor, non-NULL
+ * @param v the vertex whose list it is
+ * @param list the array, or NULL if the list is compressed
+ * @param bytes the compressed list, if list is NULL
+ */
+static inline void ldigraph_cursor_start(ldigraph_cursor *c, size_t v, const ldigraph_vertex *list, const unsigned char *bytes);
+
+
+/**
+ * Returns the neighbor at the given cursor and moves the cursor past it.
+ * The cursor must not be at the end of its list.
+ *
+ * @param c a pointer to a cursor, non-NULL
+ * @return the next neighbor
+ */
+static inline size_t ldigraph_cursor_next(ldigraph_cursor *c);
+
+
+/**
+ * Compresses the given packed lists, each as its length and then the
+ * zigzag-coded differences between consecutive neighbors (the first from
+ * the vertex itself) in variable-length bytes holding seven bits each.
+ *
+ * @param n the number of lists
+ * @param offset the start of each list in list (n + 1 entries)
+ * @param list the lists concatenated
+ * @param sorted true to sort each list first
+ * @param packed_offset a pointer to a location to store the start of
+ * each list's bytes
+ * @param packed a pointer to a location to store the bytes
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_compress_lists(size_t n, const size_t *offset, const ldigraph_vertex *list, bool sorted, size_t **packed_offset, unsigned char **packed);
+
+
+/**
+ * Compares two vertices.
+ *
+ * @param a a pointer to an ldigraph_vertex
+ * @param b a pointer to an ldigraph_vertex
+ * @return a negative number, zero, or a positive number as a is less
+ * than, equal to, or greater than b
+ */
+static int ldigraph_vertex_compare(const void *a, const void *b);
+
+
+/**
+ * Compares two vertices by their keys, smaller keys first, and by
+ * vertex number where the keys are equal.
+ *
+ * @param a a pointer to an ldigraph_vertex_key
+ * @param b a pointer to an ldigraph_vertex_key
+ * @return a negative number, zero, or a positive number as a comes
+ * before, with, or after b
+ */
+static int ldigraph_vertex_key_ascending(const void *a, const void *b);
+
+
+/**
+ * Compares two vertices by their keys, larger keys first, and by vertex
+ * number where the keys are equal.
+ *
+ * @param a a pointer to an ldigraph_vertex_key
+ * @param b a pointer to an ldigraph_vertex_key
+ * @return a negative number, zero, or a positive number as a comes
+ * before, with, or after b
+ */
+static int ldigraph_vertex_key_descending(const void *a, const void *b);
+
+
+/**
+ * Collects the neighbors of each vertex of the given graph in both
+ * directions, out-neighbors first in the order of the vertex's
+ * adjacency list and then in-neighbors in increasing order, whether or
+ * not the graph is frozen, compressed, or has in-edges.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param nb a pointer to the neighborhood to fill in, non-NULL
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_neighborhood_build(const ldigraph *g, ldigraph_neighborhood *nb);
+
+
+/**
+ * Frees the arrays of the given neighborhood.
+ *
+ * @param nb a pointer to a neighborhood, non-NULL
+ */
+static void ldigraph_neighborhood_destroy(ldigraph_neighborhood *nb);
+
+
+/**
+ * Lists the vertices in the order that breadth-first searches over the
+ * given neighborhoods reach them, starting each search from the first
+ * vertex in starts that no earlier search reached.
+ *
+ * @param n the number of vertices
+ * @param nb the neighbors of each vertex
+ * @param starts the vertices in the order to start searches from, or
+ * NULL for increasing order
+ * @param by_degree true to take the vertices first reached from each
+ * vertex lowest degree first, as Cuthill-McKee does, rather than in
+ * the order of its list
+ * @param order an array with room for n vertices to store the order in
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_order_bfs(size_t n, const ldigraph_neighborhood *nb, const ldigraph_vertex *starts, bool by_degree, ldigraph_vertex *order);
+
+
+/**
+ * Lists the vertices greedily as Gorder does: each next vertex is one
+ * with the most edges to and in-neighbors in common with the last
+ * LDIGRAPH_GORDER_WINDOW vertices listed.  In-neighbors with more than
+ * about the square root of n out-neighbors are not counted, since they
+ * relate too many vertices to say much and would take too long.
+ *
+ * @param n the number of vertices
+ * @param nb the neighbors of each vertex
+ * @param order an array with room for n vertices to store the order in
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_order_gorder(size_t n, const ldigraph_neighborhood *nb, ldigraph_vertex *order);
+
+
+/**
+ * Raises or lowers by one the score in the given Gorder state of each
+ * unnumbered vertex for each edge it has with the given vertex and each
+ * in-neighbor it has in common with it.
+ *
+ * @param go a pointer to a Gorder state, non-NULL
+ * @param nb the neighbors of each vertex
+ * @param v the vertex entering or leaving the window
+ * @param raise true to raise the scores, false to lower them
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_gorder_relate(ldigraph_gorder *go, const ldigraph_neighborhood *nb, size_t v, bool raise);
+
+
+/**
+ * Moves the given unnumbered vertex to the list for the given score in
+ * the given Gorder state, or just removes it from its list if the score
+ * is SIZE_MAX.
+ *
+ * @param go a pointer to a Gorder state, non-NULL
+ * @param v an unnumbered vertex
+ * @param score its new score, or SIZE_MAX
+ * @return true if successful, false if there was not enough memory
+ */
+static bool ldigraph_gorder_move(ldigraph_gorder *go, size_t v, size_t score);
+
+
+/**
+ * Returns the length of the shortest path between the given vertices
+ * found by breadth-first search from both ends at once, always expanding
+ * a whole level on the side with the smaller frontier and stopping at
+ * the first vertex seen from both sides.  The graph must have had its
+ * in-edges built.
+ *
+ * @param g a pointer to a directed graph with in-edges
+ * @param ws a workspace with room for both halves of a search of g
+ * @param from the index of a vertex in that graph
+ * @param to the index of a vertex in that graph
+ * @return the length of the shortest path, or -1
+ */
+static int ldigraph_bidirectional_bfs(const ldigraph *g, ldigraph_workspace *ws, size_t from, size_t to);
+
+
+/**
+ * Resizes the adjacency list for the given vertex in the given graph.
+ * 
+ * @param g a pointer to a directed graph
+ * @param from the index of a vertex in that graph
+ */
+static void ldigraph_list_embiggen(ldigraph *g, size_t from);
+
+
+/**
+ * Determines how the adjacency list of the given vertex should be
+ * indexed given its current length and the configuration of the graph.
+ *
+ * @param g a pointer to a directed graph
+ * @param v the index of a vertex in that graph
+ * @return LDIGRAPH_INDEX_NONE, LDIGRAPH_INDEX_HASH, or LDIGRAPH_INDEX_BITSET
+ */
+static int ldigraph_index_choose(const ldigraph *g, size_t v);
+
+
+/**
+ * Replaces the index of the given vertex with a new one of the kind
+ * chosen by ldigraph_index_choose, built from its adjacency list.  If
+ * there is not enough memory the vertex is left without an index,
+ * which only makes membership tests slower.
+ *
+ * @param g a pointer to a directed graph
+ * @param v the index of a vertex in that graph
+ */
+static void ldigraph_index_build(ldigraph *g, size_t v);
+
+
+/**
+ * Rebuilds the indices of all vertices in the given graph.
+ *
+ * @param g a pointer to a directed graph
+ */
+static void ldigraph_index_build_all(ldigraph *g);
+
+
+/**
+ * Updates the index of the given vertex after an edge to the given
+ * vertex has been appended to its adjacency list, changing the kind of
+ * index if the list has outgrown the current one.
+ *
+ * @param g a pointer to a directed graph
+ * @param from the index of a vertex in that graph
+ * @param to the target of the new edge
+ */
+static void ldigraph_index_update(ldigraph *g, size_t from, size_t to);
+
+
+/**
+ * Adds the given target to the given hash index, which must have room.
+ *
+ * @param idx a pointer to a hash index, non-NULL
+ * @param to a vertex index
+ */
+static void ldigraph_index_insert(ldigraph_index *idx, size_t to);
+
+
+/**
+ * Determines if the given index contains the given target.
+ *
+ * @param idx a pointer to an index, non-NULL
+ * @param to a vertex index
+ * @return true if and only if to is in the index
+ */
+static bool ldigraph_index_contains(const ldigraph_index *idx, size_t to);
+
+
+/**
+ * Returns the first slot to probe for the given target in a hash
+ * table with the given power-of-two number of slots.
+ *
+ * @param to a vertex index
+ * @param cap a power of two
+ * @return a slot index less than cap
+ */
+static size_t ldigraph_index_hash(size_t to, size_t cap);
+
+
+/**
+ * Destroys the given index.
+ *
+ * @param idx a pointer to an index, or NULL
+ */
+static void ldigraph_index_destroy(ldigraph_index *idx);
+
+
+/**
+ * Makes sure the given workspace has room to search the given graph,
+ * from both ends if requested.
+ *
+ * @param ws a pointer to a workspace, non-NULL
+ * @param g a pointer to a directed graph, non-NULL
+ * @param both true to make room for the backward half of a search too
+ * @return true if and only if there is now enough room
+ */
+static bool ldigraph_workspace_reserve(ldigraph_workspace *ws, const ldigraph *g, bool both);
+
+
+/**
+ * Prepares a search result with room for the given number of vertices.
+ * It is the responsibility of the caller to destroy the result.
+ *
+ * @param cap the number of vertices
+ * @return a pointer to a search result, or NULL
+ */
+static ldigraph_search *ldigraph_search_create(size_t cap);
+
+
+/**
+ * Makes room in the given search result for the given number of
+ * vertices.
+ *
+ * @param s a pointer to a search result, non-NULL
+ * @param cap the number of vertices
+ * @return true if and only if there is now enough room
+ */
+static bool ldigraph_search_reserve(ldigraph_search *s, size_t cap);
+
+
+/**
+ * Starts a new search of the given graph in the given search result,
+ * which must have room for its vertices.  All vertices become unseen
+ * in constant time by moving on to a new generation; stamps are only
+ * cleared when the generation counter wraps around.
+ *
+ * @param s a pointer to a search result, non-NULL
+ * @param g a pointer to a directed graph, non-NULL
+ */
+static void ldigraph_search_init(ldigraph_search *s, const ldigraph *g);
+
+
+/**
+ * Returns the color of the given vertex in the given search.
+ *
+ * @param s a pointer to a search result, non-NULL
+ * @param v the index of a vertex in the searched graph
+ * @return LDIGRAPH_UNSEEN, LDIGRAPH_PROCESSING, or LDIGRAPH_DONE
+ */
+static inline int ldigraph_search_color(const ldigraph_search *s, size_t v);
+
+
+/**
+ * Returns the distance recorded for the given vertex in the given search.
+ *
+ * @param s a pointer to a search result, non-NULL
+ * @param v the index of a vertex in the searched graph
+ * @return the distance to v, or -1 if v has not been reached
+ */
+static inline int ldigraph_search_dist(const ldigraph_search *s, size_t v);
+
+
+/**
+ * Marks the given unseen vertex as a target of the given search.  The
+ * vertex stays unseen, but its stamp is set to the current generation,
+ * which no other unseen vertex has.
+ *
+ * @param s a pointer to a search result, non-NULL
+ * @param v the index of a vertex in the searched graph
+ * @return true if v was not already marked
+ */
+static inline bool ldigraph_search_mark_target(ldigraph_search *s, size_t v);
+
+
+/**
+ * Determines if the given vertex, which must be unseen in the given
+ * search, has been marked as a target.
+ *
+ * @param s a pointer to a search result, non-NULL
+ * @param v the index of a vertex in the searched graph
+ * @return true if and only if v is marked as a target
+ */
+static inline bool ldigraph_search_is_target(const ldigraph_search *s, size_t v);
+
+
+/**
+ * Records that the given search has reached the given vertex along a
+ * path of the given length ending with an edge from the given vertex.
+ * The vertex is colored LDIGRAPH_PROCESSING.
+ *
+ * @param s a pointer to a search result, non-NULL
+ * @param v the index of a vertex in the searched graph
+ * @param dist the length of the path to v
+ * @param pred the predecessor of v, or LDIGRAPH_VERTEX_MAX for none
+ */
+static inline void ldigraph_search_reach(ldigraph_search *s, size_t v, int dist, size_t pred);
+
+
+/**
+ * Destroys the given search result.
+ *
+ * @param s a pointer to a search result, non-NULL
+ */
+static void ldigraph_search_destroy(ldigraph_search *s);
+
+
+/**
+ * Copies the edges in the given list that ldigraph_add_edge would accept
+ * (endpoints in range and not equal), grouped by ranges of sources in
+ * increasing order and otherwise in the order given.
+ *
+ * @param n the number of vertices
+ * @param from an array of m vertex indices
+ * @param to an array of m vertex indices
+ * @param m the number of edges
+ * @param grouped_from a pointer to a location to store the new sources
+ * @param grouped_to a pointer to a location to store the new destinations
+ * @param count a pointer to a location to store the number of edges kept
+ * @return true if successful, false if the edges were grouped already or
+ * there was not enough memory, in which case nothing is stored
+ */
+static bool ldigraph_group_edges(size_t n, const ldigraph_vertex *from, const ldigraph_vertex *to, size_t m, ldigraph_vertex **grouped_from, ldigraph_vertex **grouped_to, size_t *count);
+
+
+/**
+ * Removes all but the first copy of each edge from the packed adjacency
+ * lists of the given graph, keeping the rest of each list in order.
+ *
+ * @param g a pointer to a frozen, unmapped, uncompressed directed graph
+ */
+static void ldigraph_remove_repeated_edges(ldigraph *g);
+
+
+ldigraph *ldigraph_create(size_t n)
+{
+  if (n < 1 || n > LDIGRAPH_VERTEX_MAX)
+    {
+      return NULL;
+    }
+  
+  ldigraph *g = malloc(sizeof(ldigraph));
+  if (g != NULL)
+    {
+      ldigraph_init_common(g, n);
+      g->frozen = false;
+      g->offset = NULL;
+      g->targets = NULL;
+      g->list_size = malloc(sizeof(size_t) * n);
+      g->list_cap = malloc(sizeof(size_t) * n);
+      g->adj = malloc(sizeof(ldigraph_vertex *) * n);
+      
+      if (g->list_size == NULL || g->list_cap == NULL || g->adj == NULL)
+	{
+	  free(g->list_size);
+	  free(g->list_cap);
+	  free(g->adj);
+	  free(g);
+
+	  return NULL;
+	}
+
+      for (size_t i = 0; i < n; i++)
+	{
+	  g->list_size[i] = 0;
+	  g->adj[i] = malloc(sizeof(ldigraph_vertex) * LDIGRAPH_ADJ_LIST_INITIAL_CAPACITY);
+	  g->list_cap[i] = g->adj[i] != NULL ? LDIGRAPH_ADJ_LIST_INITIAL_CAPACITY : 0;
+	}
+    }
+
+  return g;
+}
+
+
+ldigraph *ldigraph_create_from_edges(size_t n, const ldigraph_vertex *from, const ldigraph_vertex *to, size_t m)
+{
+  if (n < 1 || n > LDIGRAPH_VERTEX_MAX || (m > 0 && (from == NULL || to == NULL)))
+    {
+      return NULL;
+    }
+
+  // placing the edges of a large graph in the order given misses the
+  // cache on nearly every edge, so they are grouped by ranges of sources
+  // first if there is room; the grouping keeps the order within each list
+  ldigraph_vertex *grouped_from = NULL;
+  ldigraph_vertex *grouped_to = NULL;
+  if (n > LDIGRAPH_GROUP_THRESHOLD && ldigraph_group_edges(n, from, to, m, &grouped_from, &grouped_to, &m))
+    {
+      from = grouped_from;
+      to = grouped_to;
+    }
+
+  ldigraph *g = malloc(sizeof(ldigraph));
+  if (g != NULL)
+    {
+      ldigraph_init_common(g, n);
+      g->list_size = NULL;
+      g->list_cap = NULL;
+      g->adj = NULL;
+      g->frozen = true;
+      g->offset = calloc(n + 1, sizeof(size_t));
+    }
+
+  if (g == NULL || g->offset == NULL)
+    {
+      free(g);
+      free(grouped_from);
+      free(grouped_to);
+      return NULL;
+    }
+
+  // first pass: count the out-degree of each vertex over the valid edges
+  // (the same ones ldigraph_add_edge would accept)
+  size_t valid = 0;
+  for (size_t i = 0; i < m; i++)
+    {
+      if (from[i] < n && to[i] < n && from[i] != to[i])
+	{
+	  g->offset[from[i]]++;
+	  valid++;
+	}
+    }
+
+  g->m = valid;
+  g->targets = malloc(sizeof(ldigraph_vertex) * (valid > 0 ? valid : 1));
+  if (g->targets == NULL)
+    {
+      free(g->offset);
+      free(g);
+      free(grouped_from);
+      free(grouped_to);
+      return NULL;
+    }
+
+  // turn the counts into the start of each vertex's block
+  size_t start = 0;
+  for (size_t v = 0; v < n; v++)
+    {
+      size_t count = g->offset[v];
+      g->offset[v] = start;
+      start += count;
+    }
+
+  // second pass: place each edge at the next free slot in its block;
+  // scanning the input in order keeps each list in insertion order
+  for (size_t i = 0; i < m; i++)
+    {
+      if (from[i] < n && to[i] < n && from[i] != to[i])
+	{
+	  g->targets[g->offset[from[i]]++] = to[i];
+	}
+    }
+
+  // each offset now marks the end of its block, which is the start of
+  // the next one
+  for (size_t v = n; v > 0; v--)
+    {
+      g->offset[v] = g->offset[v - 1];
+    }
+  g->offset[0] = 0;
+  free(grouped_from);
+  free(grouped_to);
+
+  ldigraph_remove_repeated_edges(g);
+  ldigraph_index_build_all(g);
+
+  return g;
+}
+
+
+bool ldigraph_group_edges(size_t n, const ldigraph_vertex *from, const ldigraph_vertex *to, size_t m, ldigraph_vertex **grouped_from, ldigraph_vertex **grouped_to, size_t *count)
+{
+  int shift = 0;
+  while ((n - 1) >> shift >= LDIGRAPH_GROUPS)
+    {
+      shift++;
+    }
+  size_t groups = ((n - 1) >> shift) + 1;
+  size_t *start = calloc(groups + 1, sizeof(size_t));
+  if (start == NULL)
+    {
+      return false;
+    }
+
+  // edges that are grouped already are left as they are
+  bool grouped = true;
+  size_t last = 0;
+  for (size_t i = 0; i < m; i++)
+    {
+      if (from[i] < n && to[i] < n && from[i] != to[i])
+	{
+	  grouped = grouped && from[i] >> shift >= last;
+	  last = from[i] >> shift;
+	  start[last + 1]++;
+	}
+    }
+  if (grouped)
+    {
+      free(start);
+      return false;
+    }
+  for (size_t r = 0; r < groups; r++)
+    {
+      start[r + 1] += start[r];
+    }
+
+  size_t valid = start[groups];
+  *grouped_from = malloc(sizeof(ldigraph_vertex) * (valid > 0 ? valid : 1));
+  *grouped_to = malloc(sizeof(ldigraph_vertex) * (valid > 0 ? valid : 1));
+  if (*grouped_from == NULL || *grouped_to == NULL)
+    {
+      free(start);
+      free(*grouped_from);
+      free(*grouped_to);
+      *grouped_from = NULL;
+      *grouped_to = NULL;
+      return false;
+    }
+
+  // each group fills its block in the order of the input
+  for (size_t i = 0; i < m; i++)
+    {
+      if (from[i] < n && to[i] < n && from[i] != to[i])
+	{
+	  size_t pos = start[from[i] >> shift]++;
+	  (*grouped_from)[pos] = from[i];
+	  (*grouped_to)[pos] = to[i];
+	}
+    }
+
+  free(start);
+  *count = valid;
+  return true;
+}
+
+
+void ldigraph_remove_repeated_edges(ldigraph *g)
+{
+  // seen[u] is one more than the last vertex with a long list found to
+  // have an edge to u; it is only needed once there is a long list
+  ldigraph_vertex *seen = NULL;
+  bool marking = true;
+  size_t kept = 0;
+  for (size_t v = 0; v < g->n; v++)
+    {
+      size_t start = g->offset[v];
+      size_t end = g->offset[v + 1];
+      g->offset[v] = kept;
+      if (end - start > LDIGRAPH_REPEAT_SCAN_LIMIT && seen == NULL && marking)
+	{
+	  seen = calloc(g->n, sizeof(ldigraph_vertex));
+	  marking = seen != NULL;
+	}
+
+      size_t first = kept;
+      for (size_t i = start; i < end; i++)
+	{
+	  ldigraph_vertex u = g->targets[i];
+	  bool repeated = false;
+	  if (end - start > LDIGRAPH_REPEAT_SCAN_LIMIT && seen != NULL)
+	    {
+	      repeated = seen[u] == v + 1;
+	      seen[u] = v + 1;
+	    }
+	  else
+	    {
+	      for (size_t j = first; j < kept && !repeated; j++)
+		{
+		  repeated = g->targets[j] == u;
+		}
+	    }
+	  if (!repeated)
+	    {
+	      g->targets[kept++] = u;
+	    }
+	}
+    }
+  g->offset[g->n] = kept;
+  free(seen);
+
+  if (kept < g->m)
+    {
+      // give back the room the repeats took if the allocator will
+      ldigraph_vertex *smaller = realloc(g->targets, sizeof(ldigraph_vertex) * (kept > 0 ? kept : 1));
+      if (smaller != NULL)
+	{
+	  g->targets = smaller;
+	}
+      g->m = kept;
+    }
+}
+
+
+bool ldigraph_save(const ldigraph *g, const char *filename)
+{
+  if (g == NULL || filename == NULL)
+    {
+      return false;
+    }
+
+  size_t m = 0;
+  for (size_t v = 0; v < g->n; v++)
+    {
+      m += ldigraph_out_degree(g, v);
+    }
+
+  // the sections each index needs, all or none of them
+  ldigraph_file_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, LDIGRAPH_FILE_MAGIC, sizeof(header.magic));
+  header.version = LDIGRAPH_FILE_VERSION;
+  header.vertex_size = sizeof(ldigraph_vertex);
+  header.offset_size = sizeof(size_t);
+  header.sections = LDIGRAPH_FILE_EDGES;
+  header.n = g->n;
+  header.m = m;
+  // lists that are not packed as in the file are left NULL here
+  const void *data[LDIGRAPH_FILE_SECTIONS] = {g->frozen ? g->offset : NULL, g->frozen ? g->targets : NULL};
+  if (ldigraph_has_in_edges(g))
+    {
+      header.sections |= LDIGRAPH_FILE_IN_EDGES;
+      data[LDIGRAPH_FILE_IN_OFFSET] = g->in_offset;
+      data[LDIGRAPH_FILE_SOURCES] = g->sources;
+    }
+  if (g->reach_low != NULL)
+    {
+      header.sections |= LDIGRAPH_FILE_REACHABILITY;
+      header.components = g->components;
+      header.reach_labels = LDIGRAPH_REACH_LABELS;
+      data[LDIGRAPH_FILE_COMPONENT] = g->component;
+      data[LDIGRAPH_FILE_LOCAL] = g->local;
+      data[LDIGRAPH_FILE_COMPONENT_OFFSET] = g->component_offset;
+      data[LDIGRAPH_FILE_MEMBERS] = g->members;
+      data[LDIGRAPH_FILE_REACH_LOW] = g->reach_low;
+      data[LDIGRAPH_FILE_REACH_POST] = g->reach_post;
+    }
+  ldigraph_file_layout(&header);
+
+  FILE *out = fopen(filename, "wb");
+  if (out == NULL)
+    {
+      return false;
+    }
+
+  size_t pos = 0;
+  bool ok = ldigraph_file_write(out, &header, sizeof(header), &pos);
+  for (int section = 0; ok && section < LDIGRAPH_FILE_SECTIONS; section++)
+    {
+      if (header.pos[section] == 0)
+	{
+	  continue;
+	}
+      
+      ok = ldigraph_file_pad(out, header.pos[section], &pos);
+      if (data[section] != NULL)
+	{
+	  ok = ok && ldigraph_file_write(out, data[section], ldigraph_file_section_size(&header, section), &pos);
+	}
+      else if (section == LDIGRAPH_FILE_OFFSET || section == LDIGRAPH_FILE_IN_OFFSET)
+	{
+	  // pack the lists as ldigraph_freeze and ldigraph_build_in_edges would
+	  size_t offset = 0;
+	  for (size_t v = 0; ok && v <= g->n; v++)
+	    {
+	      ok = ldigraph_file_write(out, &offset, sizeof(size_t), &pos);
+	      if (v < g->n)
+		{
+		  offset += section == LDIGRAPH_FILE_OFFSET ? ldigraph_out_degree(g, v) : ldigraph_in_degree(g, v);
+		}
+	    }
+	}
+      else
+	{
+	  // write the lists a buffer at a time
+	  ldigraph_vertex buffer[LDIGRAPH_FILE_BUFFER];
+	  size_t used = 0;
+	  for (size_t v = 0; ok && v < g->n; v++)
+	    {
+	      ldigraph_cursor edges;
+	      size_t count = (section == LDIGRAPH_FILE_TARGETS
+			      ? ldigraph_out_edges(g, v, &edges)
+			      : ldigraph_in_edges(g, v, &edges));
+	      for (size_t i = 0; ok && i < count; i++)
+		{
+		  buffer[used++] = ldigraph_cursor_next(&edges);
+		  if (used == LDIGRAPH_FILE_BUFFER)
+		    {
+		      ok = ldigraph_file_write(out, buffer, sizeof(buffer), &pos);
+		      used = 0;
+		    }
+		}
+	    }
+	  ok = ok && ldigraph_file_write(out, buffer, sizeof(ldigraph_vertex) * used, &pos);
+	}
+    }
+  ok = ok && ldigraph_file_pad(out, header.size, &pos);
+
+  // a partial file must not be mistaken for a good one later
+  ok = fclose(out) == 0 && ok;
+  if (!ok)
+    {
+      remove(filename);
+    }
+  return ok;
+}
+
+
+ldigraph *ldigraph_map(const char *filename)
+{
+  return ldigraph_map_file(filename, false);
+}
+
+
+ldigraph *ldigraph_map_checked(const char *filename)
+{
+  return ldigraph_map_file(filename, true);
+}
+
+
+ldigraph *ldigraph_map_file(const char *filename, bool check)
+{
+  int fd = filename != NULL ? open(filename, O_RDONLY) : -1;
+  if (fd < 0)
+    {
+      return NULL;
+    }
+
+  struct stat st;
+  void *base = MAP_FAILED;
+  size_t size = 0;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(ldigraph_file_header))
+    {
+      // graphs never write to their arrays once frozen
+      size = st.st_size;
+      base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+  close(fd);
+  if (base == MAP_FAILED)
+    {
+      return NULL;
+    }
+
+  // the sections must be where the header's sizes put them, which also
+  // keeps them inside the file
+  const ldigraph_file_header *header = base;
+  uint32_t known = LDIGRAPH_FILE_EDGES | LDIGRAPH_FILE_IN_EDGES | LDIGRAPH_FILE_REACHABILITY;
+  bool ok = (memcmp(header->magic, LDIGRAPH_FILE_MAGIC, sizeof(header->magic)) == 0
+	     && header->version == LDIGRAPH_FILE_VERSION
+	     && header->vertex_size == sizeof(ldigraph_vertex) && header->offset_size == sizeof(size_t)
+	     && header->n >= 1 && header->n <= LDIGRAPH_VERTEX_MAX && header->n < size && header->m < size
+	     && (header->sections & LDIGRAPH_FILE_EDGES) && (header->sections & ~known) == 0
+	     && header->components <= header->n
+	     && ((header->sections & LDIGRAPH_FILE_REACHABILITY)
+		 ? header->reach_labels == LDIGRAPH_REACH_LABELS && header->components > 0
+		 : header->reach_labels == 0 && header->components == 0));
+  if (ok)
+    {
+      ldigraph_file_header expected = *header;
+      ldigraph_file_layout(&expected);
+      ok = expected.size == header->size && header->size <= size
+	&& memcmp(expected.pos, header->pos, sizeof(expected.pos)) == 0;
+    }
+
+  // the contents are trusted apart from where the lists end, so that
+  // loading does not touch every page
+  char *bytes = base;
+  size_t n = ok ? header->n : 0;
+  size_t *offset = (size_t *)(bytes + (ok ? header->pos[LDIGRAPH_FILE_OFFSET] : 0));
+  size_t *in_offset = (size_t *)(bytes + (ok ? header->pos[LDIGRAPH_FILE_IN_OFFSET] : 0));
+  size_t *component_offset = (size_t *)(bytes + (ok ? header->pos[LDIGRAPH_FILE_COMPONENT_OFFSET] : 0));
+  ok = (ok && offset[0] == 0 && offset[n] == header->m
+	&& (!(header->sections & LDIGRAPH_FILE_IN_EDGES) || (in_offset[0] == 0 && in_offset[n] == header->m))
+	&& (!(header->sections & LDIGRAPH_FILE_REACHABILITY)
+	    || (component_offset[0] == 0 && component_offset[header->components] == n))
+	&& (!check || ldigraph_file_check(header, bytes)));
+  
+  ldigraph *g = ok ? malloc(sizeof(ldigraph)) : NULL;
+  if (g == NULL)
+    {
+      munmap(base, size);
+      return NULL;
+    }
+
+  ldigraph_init_common(g, n);
+  g->list_size = NULL;
+  g->list_cap = NULL;
+  g->adj = NULL;
+  g->frozen = true;
+  g->m = header->m;
+  g->offset = offset;
+  g->targets = (ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_TARGETS]);
+  if (header->sections & LDIGRAPH_FILE_IN_EDGES)
+    {
+      g->in_offset = in_offset;
+      g->sources = (ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_SOURCES]);
+    }
+  if (header->sections & LDIGRAPH_FILE_REACHABILITY)
+    {
+      g->components = header->components;
+      g->component = (ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_COMPONENT]);
+      g->local = (ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_LOCAL]);
+      g->component_offset = component_offset;
+      g->members = (ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_MEMBERS]);
+      g->reach_low = (ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_REACH_LOW]);
+      g->reach_post = (ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_REACH_POST]);
+    }
+  g->mapping = base;
+  g->mapping_size = size;
+
+  return g;
+}
+
+
+bool ldigraph_file_check(const ldigraph_file_header *header, const char *bytes)
+{
+  size_t n = header->n;
+  size_t m = header->m;
+  const size_t *offset = (const size_t *)(bytes + header->pos[LDIGRAPH_FILE_OFFSET]);
+  const ldigraph_vertex *targets = (const ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_TARGETS]);
+  size_t *in_degree = calloc(n, sizeof(size_t));
+  bool ok = in_degree != NULL;
+
+  // an offset past m would let the loops below read outside the section
+  for (size_t v = 0; ok && v < n; v++)
+    {
+      ok = offset[v] <= offset[v + 1] && offset[v + 1] <= m;
+      for (size_t i = offset[v]; ok && i < offset[v + 1]; i++)
+	{
+	  ok = targets[i] < n && targets[i] != v;
+	  if (ok)
+	    {
+	      in_degree[targets[i]]++;
+	    }
+	}
+    }
+
+  if (ok && (header->sections & LDIGRAPH_FILE_IN_EDGES))
+    {
+      const size_t *in_offset = (const size_t *)(bytes + header->pos[LDIGRAPH_FILE_IN_OFFSET]);
+      const ldigraph_vertex *sources = (const ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_SOURCES]);
+      for (size_t v = 0; ok && v < n; v++)
+	{
+	  ok = (in_offset[v] <= in_offset[v + 1] && in_offset[v + 1] <= m
+		&& in_offset[v + 1] - in_offset[v] == in_degree[v]);
+	  for (size_t i = in_offset[v]; ok && i < in_offset[v + 1]; i++)
+	    {
+	      ok = sources[i] < n && sources[i] != v;
+	    }
+	}
+    }
+
+  if (ok && (header->sections & LDIGRAPH_FILE_REACHABILITY))
+    {
+      // n members, each listed under its own component at its own local
+      // index, must be every vertex once
+      size_t count = header->components;
+      const ldigraph_vertex *component = (const ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_COMPONENT]);
+      const ldigraph_vertex *local = (const ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_LOCAL]);
+      const size_t *component_offset = (const size_t *)(bytes + header->pos[LDIGRAPH_FILE_COMPONENT_OFFSET]);
+      const ldigraph_vertex *members = (const ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_MEMBERS]);
+      for (size_t c = 0; ok && c < count; c++)
+	{
+	  ok = component_offset[c] <= component_offset[c + 1] && component_offset[c + 1] <= n;
+	  for (size_t i = component_offset[c]; ok && i < component_offset[c + 1]; i++)
+	    {
+	      size_t v = members[i];
+	      ok = v < n && component[v] == c && local[v] == i - component_offset[c];
+	    }
+	}
+      for (size_t v = 0; ok && v < n; v++)
+	{
+	  for (size_t i = offset[v]; ok && i < offset[v + 1]; i++)
+	    {
+	      ok = component[v] <= component[targets[i]];
+	    }
+	}
+
+      const ldigraph_vertex *low = (const ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_REACH_LOW]);
+      const ldigraph_vertex *post = (const ldigraph_vertex *)(bytes + header->pos[LDIGRAPH_FILE_REACH_POST]);
+      for (size_t i = 0; ok && i < header->reach_labels * count; i++)
+	{
+	  ok = low[i] <= post[i] && post[i] < count;
+	}
+    }
+
+  free(in_degree);
+  return ok;
+}
+
+
+void ldigraph_file_layout(ldigraph_file_header *header)
+{
+  size_t pos = ldigraph_file_align(sizeof(ldigraph_file_header));
+  for (int section = 0; section < LDIGRAPH_FILE_SECTIONS; section++)
+    {
+      header->pos[section] = 0;
+      if (header->sections & ldigraph_file_section_group(section))
+	{
+	  header->pos[section] = pos;
+	  pos = ldigraph_file_align(pos + ldigraph_file_section_size(header, section));
+	}
+    }
+  header->size = pos;
+}
+
+
+uint32_t ldigraph_file_section_group(int section)
+{
+  if (section <= LDIGRAPH_FILE_TARGETS)
+    {
+      return LDIGRAPH_FILE_EDGES;
+    }
+  else if (section <= LDIGRAPH_FILE_SOURCES)
+    {
+      return LDIGRAPH_FILE_IN_EDGES;
+    }
+  else
+    {
+      return LDIGRAPH_FILE_REACHABILITY;
+    }
+}
+
+
+size_t ldigraph_file_section_size(const ldigraph_file_header *header, int section)
+{
+  switch (section)
+    {
+    case LDIGRAPH_FILE_OFFSET:
+    case LDIGRAPH_FILE_IN_OFFSET:
+      return sizeof(size_t) * (header->n + 1);
+
+    case LDIGRAPH_FILE_TARGETS:
+    case LDIGRAPH_FILE_SOURCES:
+      return sizeof(ldigraph_vertex) * header->m;
+
+    case LDIGRAPH_FILE_COMPONENT_OFFSET:
+      return sizeof(size_t) * (header->components + 1);
+
+    case LDIGRAPH_FILE_REACH_LOW:
+    case LDIGRAPH_FILE_REACH_POST:
+      return sizeof(ldigraph_vertex) * header->reach_labels * header->components;
+
+    default:
+      // component, local, and members
+      return sizeof(ldigraph_vertex) * header->n;
+    }
+}
+
+
+size_t ldigraph_file_align(size_t pos)
+{
+  return (pos + LDIGRAPH_FILE_ALIGNMENT - 1) / LDIGRAPH_FILE_ALIGNMENT * LDIGRAPH_FILE_ALIGNMENT;
+}
+
+
+bool ldigraph_file_write(FILE *out, const void *data, size_t size, size_t *pos)
+{
+  *pos += size;
+  return size == 0 || fwrite(data, size, 1, out) == 1;
+}
+
+
+bool ldigraph_file_pad(FILE *out, size_t target, size_t *pos)
+{
+  bool ok = true;
+  while (ok && *pos < target)
+    {
+      ok = fputc(0, out) != EOF;
+      (*pos)++;
+    }
+  return ok;
+}
+
+
+bool ldigraph_is_mapped(const ldigraph *g, const void *p)
+{
+  return (g->mapping != NULL && (const char *)p >= (const char *)g->mapping
+	  && (const char *)p < (const char *)g->mapping + g->mapping_size);
+}
+
+
+void ldigraph_init_common(ldigraph *g, size_t n)
+{
+  g->n = n;
+  g->m = 0;
+  g->in_offset = NULL;
+  g->sources = NULL;
+  g->index = NULL;
+  g->config.index_threshold = LDIGRAPH_INDEX_DEFAULT_THRESHOLD;
+  g->config.bitset_density = LDIGRAPH_INDEX_DEFAULT_BITSET_DENSITY;
+  g->engine = LDIGRAPH_SHORTEST_AUTO;
+  g->threads = 1;
+  g->order_state = LDIGRAPH_ORDER_UNKNOWN;
+  g->order = NULL;
+  g->position = NULL;
+  g->component = NULL;
+  g->local = NULL;
+  g->components = 0;
+  g->component_offset = NULL;
+  g->members = NULL;
+  g->reach_low = NULL;
+  g->reach_post = NULL;
+  g->label_offset[LDIGRAPH_LABEL_OUT] = NULL;
+  g->label_offset[LDIGRAPH_LABEL_IN] = NULL;
+  g->labels[LDIGRAPH_LABEL_OUT] = NULL;
+  g->labels[LDIGRAPH_LABEL_IN] = NULL;
+  g->landmarks = 0;
+  g->landmark_dist = NULL;
+  g->mapping = NULL;
+  g->mapping_size = 0;
+  g->packed = NULL;
+  g->packed_offset = NULL;
+  g->in_packed = NULL;
+  g->in_packed_offset = NULL;
+}
+
+
+size_t ldigraph_size(const ldigraph *g)
+{
+  if (g != NULL)
+    {
+      return g->n;
+    }
+  else
+    {
+      return 0;
+    }
+}
+
+
+bool ldigraph_freeze(ldigraph *g)
+{
+  if (g == NULL)
+    {
+      return false;
+    }
+  else if (g->frozen)
+    {
+      return true;
+    }
+
+  // count edges so the packed arrays can be allocated at once
+  size_t m = 0;
+  for (size_t i = 0; i < g->n; i++)
+    {
+      m += g->list_size[i];
+    }
+  
+  size_t *offset = malloc(sizeof(size_t) * (g->n + 1));
+  ldigraph_vertex *targets = malloc(sizeof(ldigraph_vertex) * (m > 0 ? m : 1));
+  if (offset == NULL || targets == NULL)
+    {
+      // leave the graph as it was
+      free(offset);
+      free(targets);
+      return false;
+    }
+
+  // copy each list to the end of the packed array, keeping edge order
+  offset[0] = 0;
+  for (size_t i = 0; i < g->n; i++)
+    {
+      for (size_t j = 0; j < g->list_size[i]; j++)
+	{
+	  targets[offset[i] + j] = g->adj[i][j];
+	}
+      offset[i + 1] = offset[i] + g->list_size[i];
+      free(g->adj[i]);
+    }
+
+  free(g->adj);
+  free(g->list_cap);
+  free(g->list_size);
+  g->adj = NULL;
+  g->list_cap = NULL;
+  g->list_size = NULL;
+
+  g->m = m;
+  g->offset = offset;
+  g->targets = targets;
+  g->frozen = true;
+
+  return true;
+}
+
+
+size_t ldigraph_out_edges(const ldigraph *g, size_t v, ldigraph_cursor *c)
+{
+  if (!g->frozen)
+    {
+      ldigraph_cursor_start(c, v, g->adj[v], NULL);
+      return g->list_size[v];
+    }
+  else if (g->packed != NULL)
+    {
+      const unsigned char *bytes = g->packed + g->packed_offset[v];
+      size_t count = ldigraph_varint_read(&bytes);
+      ldigraph_cursor_start(c, v, NULL, bytes);
+      return count;
+    }
+  else
+    {
+      ldigraph_cursor_start(c, v, g->targets + g->offset[v], NULL);
+      return g->offset[v + 1] - g->offset[v];
+    }
+}
+
+
+size_t ldigraph_out_degree(const ldigraph *g, size_t v)
+{
+  if (!g->frozen)
+    {
+      return g->list_size[v];
+    }
+  else if (g->packed != NULL)
+    {
+      const unsigned char *bytes = g->packed + g->packed_offset[v];
+      return ldigraph_varint_read(&bytes);
+    }
+  else
+    {
+      return g->offset[v + 1] - g->offset[v];
+    }
+}
+
+
+size_t ldigraph_in_degree(const ldigraph *g, size_t v)
+{
+  if (g->in_packed != NULL)
+    {
+      const unsigned char *bytes = g->in_packed + g->in_packed_offset[v];
+      return ldigraph_varint_read(&bytes);
+    }
+  else
+    {
+      return g->in_offset[v + 1] - g->in_offset[v];
+    }
+}
+
+
+bool ldigraph_has_in_edges(const ldigraph *g)
+{
+  return g->in_offset != NULL || g->in_packed != NULL;
+}
+
+
+uint64_t ldigraph_varint_read(const unsigned char **bytes)
+{
+  const unsigned char *p = *bytes;
+  uint64_t value = p[0];
+  if (value < 0x80)
+    {
+      *bytes = p + 1;
+      return value;
+    }
+
+  // most gaps in graphs worth compressing fit in one or two bytes
+  value = (value & 0x7f) | (uint64_t)(p[1] & 0x7f) << 7;
+  int shift = 14;
+  p += 2;
+  while (p[-1] & 0x80)
+    {
+      value |= (uint64_t)(*p & 0x7f) << shift;
+      shift += 7;
+      p++;
+    }
+  *bytes = p;
+  return value;
+}
+
+
+void ldigraph_cursor_start(ldigraph_cursor *c, size_t v, const ldigraph_vertex *list, const unsigned char *bytes)
+{
+  c->list = list;
+  c->bytes = bytes;
+  c->last = v;
+}
+
+
+size_t ldigraph_cursor_next(ldigraph_cursor *c)
+{
+  if (c->list != NULL)
+    {
+      return *c->list++;
+    }
+
+  // the gap is zigzag-coded so that small negative gaps are small too
+  uint64_t code = ldigraph_varint_read(&c->bytes);
+  c->last += (code >> 1) ^ -(code & 1);
+  return c->last;
+}
+
+
+bool ldigraph_compress(ldigraph *g, bool sorted)
+{
+  if (g == NULL || !ldigraph_freeze(g))
+    {
+      return false;
+    }
+  else if (g->packed != NULL)
+    {
+      return true;
+    }
+
+  size_t *packed_offset = NULL;
+  unsigned char *packed = NULL;
+  size_t *in_packed_offset = NULL;
+  unsigned char *in_packed = NULL;
+  if (!ldigraph_compress_lists(g->n, g->offset, g->targets, sorted, &packed_offset, &packed)
+      || (g->in_offset != NULL
+	  && !ldigraph_compress_lists(g->n, g->in_offset, g->sources, false, &in_packed_offset, &in_packed)))
+    {
+      // leave the graph as it was
+      free(packed_offset);
+      free(packed);
+      return false;
+    }
+
+  // the packed arrays go unless they are part of a mapped file
+  if (!ldigraph_is_mapped(g, g->offset))
+    {
+      free(g->offset);
+      free(g->targets);
+    }
+  g->offset = NULL;
+  g->targets = NULL;
+  g->packed = packed;
+  g->packed_offset = packed_offset;
+  if (in_packed != NULL)
+    {
+      if (!ldigraph_is_mapped(g, g->in_offset))
+	{
+	  free(g->in_offset);
+	  free(g->sources);
+	}
+      g->in_offset = NULL;
+      g->sources = NULL;
+      g->in_packed = in_packed;
+      g->in_packed_offset = in_packed_offset;
+    }
+
+  return true;
+}
+
+
+size_t ldigraph_edge_bytes(const ldigraph *g)
+{
+  if (g == NULL)
+    {
+      return 0;
+    }
+  else if (!g->frozen)
+    {
+      size_t bytes = sizeof(ldigraph_vertex *) * g->n + 2 * sizeof(size_t) * g->n;
+      for (size_t v = 0; v < g->n; v++)
+	{
+	  bytes += sizeof(ldigraph_vertex) * g->list_cap[v];
+	}
+      return bytes;
+    }
+
+  // each direction has an offset for each vertex, and then the lists
+  size_t bytes = sizeof(size_t) * (g->n + 1);
+  if (g->packed != NULL)
+    {
+      bytes += g->packed_offset[g->n];
+    }
+  else
+    {
+      bytes += sizeof(ldigraph_vertex) * g->m;
+    }
+
+  if (g->in_packed != NULL)
+    {
+      bytes += sizeof(size_t) * (g->n + 1) + g->in_packed_offset[g->n];
+    }
+  else if (g->in_offset != NULL)
+    {
+      bytes += sizeof(size_t) * (g->n + 1) + sizeof(ldigraph_vertex) * g->m;
+    }
+  return bytes;
+}
+
+
+bool ldigraph_compress_lists(size_t n, const size_t *offset, const ldigraph_vertex *list, bool sorted, size_t **packed_offset, unsigned char **packed)
+{
+  // most gaps take a byte or two; grow as needed and trim at the end
+  size_t cap = offset[n] + n + 16;
+  size_t longest = 0;
+  for (size_t v = 0; v < n; v++)
+    {
+      if (offset[v + 1] - offset[v] > longest)
+	{
+	  longest = offset[v + 1] - offset[v];
+	}
+    }
+  *packed_offset = malloc(sizeof(size_t) * (n + 1));
+  *packed = malloc(cap);
+  ldigraph_vertex *copy = sorted ? malloc(sizeof(ldigraph_vertex) * (longest > 0 ? longest : 1)) : NULL;
+  bool ok = *packed_offset != NULL && *packed != NULL && (copy != NULL || !sorted);
+
+  size_t size = 0;
+  for (size_t v = 0; ok && v < n; v++)
+    {
+      (*packed_offset)[v] = size;
+      size_t count = offset[v + 1] - offset[v];
+      const ldigraph_vertex *neighbors = list + offset[v];
+      if (sorted)
+	{
+	  memcpy(copy, neighbors, sizeof(ldigraph_vertex) * count);
+	  qsort(copy, count, sizeof(ldigraph_vertex), ldigraph_vertex_compare);
+	  neighbors = copy;
+	}
+      
+      // ten bytes is enough for the length or any 64-bit gap
+      if (cap - size < (count + 1) * 10 && ok)
+	{
+	  size_t bigger_cap = cap * 2 > size + (count + 1) * 10 ? cap * 2 : size + (count + 1) * 10;
+	  unsigned char *bigger = realloc(*packed, bigger_cap);
+	  ok = bigger != NULL;
+	  if (ok)
+	    {
+	      *packed = bigger;
+	      cap = bigger_cap;
+	    }
+	}
+
+      size_t last = v;
+      for (size_t i = 0; ok && i <= count; i++)
+	{
+	  uint64_t code = count;
+	  if (i > 0)
+	    {
+	      uint64_t gap = (uint64_t)neighbors[i - 1] - (uint64_t)last;
+	      code = (gap << 1) ^ -(gap >> 63);
+	      last = neighbors[i - 1];
+	    }
+	  
+	  while (code >= 0x80)
+	    {
+	      (*packed)[size++] = (code & 0x7f) | 0x80;
+	      code >>= 7;
+	    }
+	  (*packed)[size++] = code;
+	}
+    }
+
+  if (ok)
+    {
+      (*packed_offset)[n] = size;
+      unsigned char *trimmed = realloc(*packed, size > 0 ? size : 1);
+      *packed = trimmed != NULL ? trimmed : *packed;
+    }
+  else
+    {
+      free(*packed_offset);
+      free(*packed);
+      *packed_offset = NULL;
+      *packed = NULL;
+    }
+  free(copy);
+  return ok;
+}
+
+
+int ldigraph_vertex_compare(const void *a, const void *b)
+{
+  ldigraph_vertex v = *(const ldigraph_vertex *)a;
+  ldigraph_vertex w = *(const ldigraph_vertex *)b;
+  return v < w ? -1 : (v > w ? 1 : 0);
+}
+
+
+int ldigraph_vertex_key_ascending(const void *a, const void *b)
+{
+  const ldigraph_vertex_key *k1 = a;
+  const ldigraph_vertex_key *k2 = b;
+
+  // break ties by vertex so the order doesn't depend on qsort
+  if (k1->key != k2->key)
+    {
+      return k1->key < k2->key ? -1 : 1;
+    }
+  return ldigraph_vertex_compare(&k1->vertex, &k2->vertex);
+}
+
+
+int ldigraph_vertex_key_descending(const void *a, const void *b)
+{
+  const ldigraph_vertex_key *k1 = a;
+  const ldigraph_vertex_key *k2 = b;
+
+  if (k1->key != k2->key)
+    {
+      return k1->key > k2->key ? -1 : 1;
+    }
+  return ldigraph_vertex_compare(&k1->vertex, &k2->vertex);
+}
+
+
+ldigraph *ldigraph_reorder(const ldigraph *g, ldigraph_reorder_strategy strategy, ldigraph_vertex **forward, ldigraph_vertex **inverse)
+{
+  if (g == NULL || forward == NULL || inverse == NULL
+      || strategy < LDIGRAPH_REORDER_BFS || strategy > LDIGRAPH_REORDER_GORDER)
+    {
+      return NULL;
+    }
+
+  size_t n = g->n;
+  ldigraph_neighborhood nb = {NULL, NULL, NULL};
+  ldigraph_vertex *order = malloc(sizeof(ldigraph_vertex) * n);
+  ldigraph_vertex *number = malloc(sizeof(ldigraph_vertex) * n);
+  bool ok = order != NULL && number != NULL && ldigraph_neighborhood_build(g, &nb);
+
+  if (ok && (strategy == LDIGRAPH_REORDER_RCM || strategy == LDIGRAPH_REORDER_DEGREE))
+    {
+      // Cuthill-McKee starts from the lowest degrees, while the degree
+      // order puts the highest first
+      ldigraph_vertex_key *by_degree = malloc(sizeof(ldigraph_vertex_key) * n);
+      ok = by_degree != NULL;
+      for (size_t v = 0; ok && v < n; v++)
+	{
+	  by_degree[v].vertex = v;
+	  by_degree[v].key = nb.offset[v + 1] - nb.offset[v];
+	}
+      if (ok)
+	{
+	  qsort(by_degree, n, sizeof(ldigraph_vertex_key),
+		strategy == LDIGRAPH_REORDER_RCM ? ldigraph_vertex_key_ascending : ldigraph_vertex_key_descending);
+	  // the final order, or where Cuthill-McKee starts its searches
+	  ldigraph_vertex *sorted = strategy == LDIGRAPH_REORDER_DEGREE ? order : number;
+	  for (size_t i = 0; i < n; i++)
+	    {
+	      sorted[i] = by_degree[i].vertex;
+	    }
+	}
+      free(by_degree);
+    }
+
+  if (ok && strategy == LDIGRAPH_REORDER_BFS)
+    {
+      ok = ldigraph_order_bfs(n, &nb, NULL, false, order);
+    }
+  else if (ok && strategy == LDIGRAPH_REORDER_RCM)
+    {
+      ok = ldigraph_order_bfs(n, &nb, number, true, order);
+      for (size_t i = 0; ok && i < n / 2; i++)
+	{
+	  ldigraph_vertex v = order[i];
+	  order[i] = order[n - 1 - i];
+	  order[n - 1 - i] = v;
+	}
+    }
+  else if (ok && strategy == LDIGRAPH_REORDER_GORDER)
+    {
+      ok = ldigraph_order_gorder(n, &nb, order);
+    }
+  ldigraph_neighborhood_destroy(&nb);
+
+  // the copy's edges, taken list by list in the new order so that each
+  // list keeps the order of the original
+  size_t m = 0;
+  for (size_t v = 0; ok && v < n; v++)
+    {
+      number[order[v]] = v;
+      m += ldigraph_out_degree(g, v);
+    }
+  ldigraph_vertex *from = ok ? malloc(sizeof(ldigraph_vertex) * (m > 0 ? m : 1)) : NULL;
+  ldigraph_vertex *to = ok ? malloc(sizeof(ldigraph_vertex) * (m > 0 ? m : 1)) : NULL;
+  ldigraph *copy = NULL;
+  if (from != NULL && to != NULL)
+    {
+      size_t e = 0;
+      for (size_t w = 0; w < n; w++)
+	{
+	  ldigraph_cursor c;
+	  size_t count = ldigraph_out_edges(g, order[w], &c);
+	  for (size_t i = 0; i < count; i++)
+	    {
+	      from[e] = w;
+	      to[e] = number[ldigraph_cursor_next(&c)];
+	      e++;
+	    }
+	}
+      copy = ldigraph_create_from_edges(n, from, to, m);
+    }
+  free(from);
+  free(to);
+
+  if (copy == NULL)
+    {
+      free(order);
+      free(number);
+      return NULL;
+    }
+
+  copy->engine = g->engine;
+  copy->threads = g->threads;
+  if (copy->config.index_threshold != g->config.index_threshold
+      || copy->config.bitset_density != g->config.bitset_density)
+    {
+      ldigraph_set_adjacency_config(copy, g->config);
+    }
+  *forward = number;
+  *inverse = order;
+  return copy;
+}
+
+
+bool ldigraph_neighborhood_build(const ldigraph *g, ldigraph_neighborhood *nb)
+{
+  size_t n = g->n;
+  nb->offset = calloc(n + 1, sizeof(size_t));
+  nb->split = malloc(sizeof(size_t) * n);
+  nb->list = NULL;
+  size_t *next = malloc(sizeof(size_t) * n);
+  if (nb->offset == NULL || nb->split == NULL || next == NULL)
+    {
+      ldigraph_neighborhood_destroy(nb);
+      free(next);
+      return false;
+    }
+
+  // count each vertex's neighbors in both directions, then make the
+  // counts into the start of each vertex's block
+  for (size_t v = 0; v < n; v++)
+    {
+      ldigraph_cursor c;
+      size_t count = ldigraph_out_edges(g, v, &c);
+      nb->offset[v + 1] += count;
+      for (size_t i = 0; i < count; i++)
+	{
+	  nb->offset[ldigraph_cursor_next(&c) + 1]++;
+	}
+    }
+  for (size_t v = 0; v < n; v++)
+    {
+      nb->offset[v + 1] += nb->offset[v];
+    }
+
+  nb->list = malloc(sizeof(ldigraph_vertex) * (nb->offset[n] > 0 ? nb->offset[n] : 1));
+  if (nb->list == NULL)
+    {
+      ldigraph_neighborhood_destroy(nb);
+      free(next);
+      return false;
+    }
+
+  for (size_t v = 0; v < n; v++)
+    {
+      nb->split[v] = nb->offset[v] + ldigraph_out_degree(g, v);
+      next[v] = nb->split[v];
+    }
+  for (size_t v = 0; v < n; v++)
+    {
+      ldigraph_cursor c;
+      size_t count = ldigraph_out_edges(g, v, &c);
+      for (size_t i = 0; i < count; i++)
+	{
+	  size_t u = ldigraph_cursor_next(&c);
+	  nb->list[nb->offset[v] + i] = u;
+	  nb->list[next[u]++] = v;
+	}
+    }
+
+  free(next);
+  return true;
+}
+
+
+void ldigraph_neighborhood_destroy(ldigraph_neighborhood *nb)
+{
+  free(nb->offset);
+  free(nb->split);
+  free(nb->list);
+  nb->offset = NULL;
+  nb->split = NULL;
+  nb->list = NULL;
+}
+
+
+bool ldigraph_order_bfs(size_t n, const ldigraph_neighborhood *nb, const ldigraph_vertex *starts, bool by_degree, ldigraph_vertex *order)
+{
+  bool *reached = calloc(n, sizeof(bool));
+  ldigraph_vertex_key *by = by_degree ? malloc(sizeof(ldigraph_vertex_key) * n) : NULL;
+  if (reached == NULL || (by_degree && by == NULL))
+    {
+      free(reached);
+      free(by);
+      return false;
+    }
+
+  // the order is the queue
+  size_t head = 0;
+  size_t tail = 0;
+  for (size_t i = 0; i < n; i++)
+    {
+      size_t s = starts != NULL ? starts[i] : i;
+      if (reached[s])
+	{
+	  continue;
+	}
+      reached[s] = true;
+      order[tail++] = s;
+
+      while (head < tail)
+	{
+	  size_t v = order[head++];
+	  size_t first = tail;
+	  for (size_t j = nb->offset[v]; j < nb->offset[v + 1]; j++)
+	    {
+	      size_t u = nb->list[j];
+	      if (!reached[u])
+		{
+		  reached[u] = true;
+		  order[tail++] = u;
+		}
+	    }
+
+	  if (by_degree && tail - first > 1)
+	    {
+	      for (size_t j = first; j < tail; j++)
+		{
+		  by[j - first].vertex = order[j];
+		  by[j - first].key = nb->offset[order[j] + 1] - nb->offset[order[j]];
+		}
+	      qsort(by, tail - first, sizeof(ldigraph_vertex_key), ldigraph_vertex_key_ascending);
+	      for (size_t j = first; j < tail; j++)
+		{
+		  order[j] = by[j - first].vertex;
+		}
+	    }
+	}
+    }
+
+  free(reached);
+  free(by);
+  return true;
+}
+
+
+bool ldigraph_order_gorder(size_t n, const ldigraph_neighborhood *nb, ldigraph_vertex *order)
+{
+  ldigraph_gorder go;
+  go.score = calloc(n, sizeof(size_t));
+  go.numbered = calloc(n, sizeof(bool));
+  go.cap = LDIGRAPH_GORDER_WINDOW * 4;
+  go.first = malloc(sizeof(ldigraph_vertex) * go.cap);
+  go.top = 0;
+  go.next = malloc(sizeof(ldigraph_vertex) * n);
+  go.prev = malloc(sizeof(ldigraph_vertex) * n);
+  go.hub = 1;
+  while (go.hub * go.hub < n)
+    {
+      go.hub++;
+    }
+  bool ok = go.score != NULL && go.numbered != NULL && go.first != NULL && go.next != NULL && go.prev != NULL;
+
+  if (ok)
+    {
+      for (size_t s = 0; s < go.cap; s++)
+	{
+	  go.first[s] = LDIGRAPH_VERTEX_MAX;
+	}
+
+      // everything starts with no score, lowest number first, so each
+      // time nothing is related to the window the lowest unnumbered
+      // vertex is next
+      for (size_t v = 0; v < n; v++)
+	{
+	  go.prev[v] = v > 0 ? v - 1 : LDIGRAPH_VERTEX_MAX;
+	  go.next[v] = v < n - 1 ? v + 1 : LDIGRAPH_VERTEX_MAX;
+	}
+      go.first[0] = 0;
+    }
+
+  for (size_t i = 0; ok && i < n; i++)
+    {
+      while (go.first[go.top] == LDIGRAPH_VERTEX_MAX)
+	{
+	  go.top--;
+	}
+      size_t v = go.first[go.top];
+      ok = ldigraph_gorder_move(&go, v, SIZE_MAX);
+      go.numbered[v] = true;
+      order[i] = v;
+
+      ok = ok && ldigraph_gorder_relate(&go, nb, v, true);
+      if (ok && i >= LDIGRAPH_GORDER_WINDOW)
+	{
+	  ok = ldigraph_gorder_relate(&go, nb, order[i - LDIGRAPH_GORDER_WINDOW], false);
+	}
+    }
+
+  free(go.score);
+  free(go.numbered);
+  free(go.first);
+  free(go.next);
+  free(go.prev);
+  return ok;
+}
+
+
+bool ldigraph_gorder_relate(ldigraph_gorder *go, const ldigraph_neighborhood *nb, size_t v, bool raise)
+{
+  bool ok = true;
+  for (size_t j = nb->offset[v]; ok && j < nb->offset[v + 1]; j++)
+    {
+      size_t u = nb->list[j];
+      if (!go->numbered[u])
+	{
+	  ok = ldigraph_gorder_move(go, u, raise ? go->score[u] + 1 : go->score[u] - 1);
+	}
+    }
+
+  // vertices with a common in-neighbor are its other out-neighbors
+  for (size_t j = nb->split[v]; ok && j < nb->offset[v + 1]; j++)
+    {
+      size_t x = nb->list[j];
+      if (nb->split[x] - nb->offset[x] > go->hub)
+	{
+	  continue;
+	}
+      for (size_t k = nb->offset[x]; ok && k < nb->split[x]; k++)
+	{
+	  size_t u = nb->list[k];
+	  if (!go->numbered[u])
+	    {
+	      ok = ldigraph_gorder_move(go, u, raise ? go->score[u] + 1 : go->score[u] - 1);
+	    }
+	}
+    }
+
+  return ok;
+}
+
+
+bool ldigraph_gorder_move(ldigraph_gorder *go, size_t v, size_t score)
+{
+  if (score != SIZE_MAX && score >= go->cap)
+    {
+      size_t bigger_cap = go->cap * 2 > score ? go->cap * 2 : score + 1;
+      ldigraph_vertex *bigger = realloc(go->first, sizeof(ldigraph_vertex) * bigger_cap);
+      if (bigger == NULL)
+	{
+	  return false;
+	}
+      for (size_t s = go->cap; s < bigger_cap; s++)
+	{
+	  bigger[s] = LDIGRAPH_VERTEX_MAX;
+	}
+      go->first = bigger;
+      go->cap = bigger_cap;
+    }
+
+  if (go->prev[v] != LDIGRAPH_VERTEX_MAX)
+    {
+      go->next[go->prev[v]] = go->next[v];
+    }
+  else
+    {
+      go->first[go->score[v]] = go->next[v];
+    }
+  if (go->next[v] != LDIGRAPH_VERTEX_MAX)
+    {
+      go->prev[go->next[v]] = go->prev[v];
+    }
+
+  if (score != SIZE_MAX)
+    {
+      go->prev[v] = LDIGRAPH_VERTEX_MAX;
+      go->next[v] = go->first[score];
+      if (go->first[score] != LDIGRAPH_VERTEX_MAX)
+	{
+	  go->prev[go->first[score]] = v;
+	}
+      go->first[score] = v;
+      go->score[v] = score;
+      go->top = score > go->top ? score : go->top;
+    }
+
+  return true;
+}
+
+
+bool ldigraph_build_in_edges(ldigraph *g)
+{
+  if (g == NULL || !ldigraph_freeze(g))
+    {
+      return false;
+    }
+  else if (ldigraph_has_in_edges(g))
+    {
+      return true;
+    }
+  
+  size_t m = g->m;
+  size_t *in_offset = calloc(g->n + 1, sizeof(size_t));
+  ldigraph_vertex *sources = malloc(sizeof(ldigraph_vertex) * (m > 0 ? m : 1));
+  if (in_offset == NULL || sources == NULL)
+    {
+      free(in_offset);
+      free(sources);
+      return false;
+    }
+
+  // counting sort of the edges by target, as in ldigraph_create_from_edges;
+  // each in-edge list ends up in increasing order of source
+  for (size_t u = 0; u < g->n; u++)
+    {
+      ldigraph_cursor edges;
+      size_t count = ldigraph_out_edges(g, u, &edges);
+      for (size_t i = 0; i < count; i++)
+	{
+	  in_offset[ldigraph_cursor_next(&edges)]++;
+	}
+    }
+
+  size_t start = 0;
+  for (size_t v = 0; v < g->n; v++)
+    {
+      size_t count = in_offset[v];
+      in_offset[v] = start;
+      start += count;
+    }
+
+  for (size_t u = 0; u < g->n; u++)
+    {
+      ldigraph_cursor edges;
+      size_t count = ldigraph_out_edges(g, u, &edges);
+      for (size_t i = 0; i < count; i++)
+	{
+	  sources[in_offset[ldigraph_cursor_next(&edges)]++] = u;
+	}
+    }
+  
+  for (size_t v = g->n; v > 0; v--)
+    {
+      in_offset[v] = in_offset[v - 1];
+    }
+  in_offset[0] = 0;
+
+  // a compressed graph gets compressed in-edges too
+  if (g->packed != NULL
+      && !ldigraph_compress_lists(g->n, in_offset, sources, false, &g->in_packed_offset, &g->in_packed))
+    {
+      free(in_offset);
+      free(sources);
+      return false;
+    }
+  
+  if (g->in_packed != NULL)
+    {
+      free(in_offset);
+      free(sources);
+    }
+  else
+    {
+      g->in_offset = in_offset;
+      g->sources = sources;
+    }
+  
+  return true;
+}
+
+
+size_t ldigraph_in_edges(const ldigraph *g, size_t v, ldigraph_cursor *c)
+{
+  if (g->in_packed != NULL)
+    {
+      const unsigned char *bytes = g->in_packed + g->in_packed_offset[v];
+      size_t count = ldigraph_varint_read(&bytes);
+      ldigraph_cursor_start(c, v, NULL, bytes);
+      return count;
+    }
+  else
+    {
+      ldigraph_cursor_start(c, v, g->sources + g->in_offset[v], NULL);
+      return g->in_offset[v + 1] - g->in_offset[v];
+    }
+}
+
+
+void ldigraph_list_embiggen(ldigraph *g, size_t from)
+{
+  if (g->list_cap[from] != 0)
+    {
+      g->adj[from] = realloc(g->adj[from], sizeof(ldigraph_vertex) * g->list_cap[from] * 2);
+      g->list_cap[from] = g->adj[from] != NULL ? g->list_cap[from] * 2 : 0;
+    }
+}
+
+
+void ldigraph_add_edge(ldigraph *g, size_t from, size_t to)
+{
+  if (g != NULL && !g->frozen && from >= 0 && to >= 0 && from < g->n && to < g->n && from != to)
+    {
+      // make room if necessary
+      if (g->list_size[from] == g->list_cap[from])
+	{
+	  ldigraph_list_embiggen(g, from);
+	}
+
+      // add to end of array if there is room
+      if (g->list_size[from] < g->list_cap[from])
+	{
+	  g->adj[from][g->list_size[from]++] = to;
+	  ldigraph_index_update(g, from, to);
+	}
+    }
+}
+
+
+bool ldigraph_has_edge(const ldigraph *g, size_t from, size_t to)
+{
+  if (g != NULL && from < g->n && to < g->n && from != to)
+    {
+      // use the index for long lists
+      if (g->index != NULL && g->index[from] != NULL)
+	{
+	  return ldigraph_index_contains(g->index[from], to);
+	}
+      
+      // sequential search of from's adjacency list
+      ldigraph_cursor edges;
+      size_t count = ldigraph_out_edges(g, from, &edges);
+      size_t i = 0;
+      while (i < count && ldigraph_cursor_next(&edges) != to)
+	{
+	  i++;
+	}
+      return i < count;
+    }
+  else
+    {
+      return false;
+    }
+}
+
+
+void ldigraph_set_adjacency_config(ldigraph *g, ldigraph_adjacency_config config)
+{
+  if (g != NULL)
+    {
+      g->config = config;
+      ldigraph_index_build_all(g);
+    }
+}
+
+
+ldigraph_adjacency_config ldigraph_get_adjacency_config(const ldigraph *g)
+{
+  if (g != NULL)
+    {
+      return g->config;
+    }
+  else
+    {
+      ldigraph_adjacency_config none = {0, 0.0};
+      return none;
+    }
+}
+
+
+ldigraph_adjacency_stats ldigraph_adjacency_report(const ldigraph *g)
+{
+  ldigraph_adjacency_stats stats = {0, 0, 0, 0};
+  if (g == NULL)
+    {
+      return stats;
+    }
+  
+  for (size_t v = 0; v < g->n; v++)
+    {
+      const ldigraph_index *idx = g->index != NULL ? g->index[v] : NULL;
+      if (idx == NULL)
+	{
+	  stats.linear++;
+	}
+      else if (idx->kind == LDIGRAPH_INDEX_HASH)
+	{
+	  stats.hashed++;
+	  stats.index_bytes += sizeof(ldigraph_index) + sizeof(ldigraph_vertex) * idx->cap;
+	}
+      else
+	{
+	  stats.bitset++;
+	  stats.index_bytes += sizeof(ldigraph_index) + sizeof(uint64_t) * idx->cap;
+	}
+    }
+
+  return stats;
+}
+
+
+int ldigraph_index_choose(const ldigraph *g, size_t v)
+{
+  size_t count = ldigraph_out_degree(g, v);
+
+  if (g->config.index_threshold == 0 || count < g->config.index_threshold)
+    {
+      return LDIGRAPH_INDEX_NONE;
+    }
+  else if (count >= g->config.bitset_density * g->n)
+    {
+      return LDIGRAPH_INDEX_BITSET;
+    }
+  else
+    {
+      return LDIGRAPH_INDEX_HASH;
+    }
+}
+
+
+void ldigraph_index_build(ldigraph *g, size_t v)
+{
+  if (g->index != NULL)
+    {
+      ldigraph_index_destroy(g->index[v]);
+      g->index[v] = NULL;
+    }
+
+  int kind = ldigraph_index_choose(g, v);
+  if (kind == LDIGRAPH_INDEX_NONE)
+    {
+      return;
+    }
+
+  // the array of indices is only created once some list needs one
+  if (g->index == NULL && (g->index = calloc(g->n, sizeof(ldigraph_index *))) == NULL)
+    {
+      return;
+    }
+  
+  ldigraph_index *idx = malloc(sizeof(ldigraph_index));
+  if (idx == NULL)
+    {
+      return;
+    }
+
+  ldigraph_cursor edges;
+  size_t count = ldigraph_out_edges(g, v, &edges);
+  
+  idx->kind = kind;
+  idx->count = 0;
+  idx->slots = NULL;
+  idx->bits = NULL;
+  if (kind == LDIGRAPH_INDEX_HASH)
+    {
+      // keep the load factor at most 1/2 so probe sequences stay short
+      idx->cap = 1;
+      while (idx->cap < count * 2)
+	{
+	  idx->cap *= 2;
+	}
+      
+      idx->slots = malloc(sizeof(ldigraph_vertex) * idx->cap);
+      if (idx->slots != NULL)
+	{
+	  for (size_t i = 0; i < idx->cap; i++)
+	    {
+	      idx->slots[i] = LDIGRAPH_INDEX_EMPTY_SLOT;
+	    }
+	  for (size_t i = 0; i < count; i++)
+	    {
+	      ldigraph_index_insert(idx, ldigraph_cursor_next(&edges));
+	    }
+	}
+    }
+  else
+    {
+      idx->cap = (g->n + 63) / 64;
+      idx->bits = calloc(idx->cap, sizeof(uint64_t));
+      if (idx->bits != NULL)
+	{
+	  for (size_t i = 0; i < count; i++)
+	    {
+	      size_t to = ldigraph_cursor_next(&edges);
+	      idx->bits[to / 64] |= (uint64_t)1 << (to % 64);
+	    }
+	}
+    }
+
+  if (idx->slots == NULL && idx->bits == NULL)
+    {
+      free(idx);
+      return;
+    }
+  
+  g->index[v] = idx;
+}
+
+
+void ldigraph_index_build_all(ldigraph *g)
+{
+  for (size_t v = 0; v < g->n; v++)
+    {
+      ldigraph_index_build(g, v);
+    }
+}
+
+
+void ldigraph_index_update(ldigraph *g, size_t from, size_t to)
+{
+  ldigraph_index *idx = g->index != NULL ? g->index[from] : NULL;
+  int kind = ldigraph_index_choose(g, from);
+  
+  if (idx != NULL && idx->kind == kind && kind == LDIGRAPH_INDEX_BITSET)
+    {
+      idx->bits[to / 64] |= (uint64_t)1 << (to % 64);
+    }
+  else if (idx != NULL && idx->kind == kind && (idx->count + 1) * 2 <= idx->cap)
+    {
+      ldigraph_index_insert(idx, to);
+    }
+  else if (idx != NULL || kind != LDIGRAPH_INDEX_NONE)
+    {
+      // new kind of index or the hash table is full; rebuilding from
+      // scratch is amortized over the edges added since the last time
+      ldigraph_index_build(g, from);
+    }
+}
+
+
+void ldigraph_index_insert(ldigraph_index *idx, size_t to)
+{
+  size_t i = ldigraph_index_hash(to, idx->cap);
+  while (idx->slots[i] != LDIGRAPH_INDEX_EMPTY_SLOT)
+    {
+      i = (i + 1) & (idx->cap - 1);
+    }
+  idx->slots[i] = to;
+  idx->count++;
+}
+
+
+bool ldigraph_index_contains(const ldigraph_index *idx, size_t to)
+{
+  if (idx->kind == LDIGRAPH_INDEX_BITSET)
+    {
+      return (idx->bits[to / 64] >> (to % 64)) & 1;
+    }
+
+  // linear probing until we find to or an empty slot
+  size_t i = ldigraph_index_hash(to, idx->cap);
+  while (idx->slots[i] != LDIGRAPH_INDEX_EMPTY_SLOT)
+    {
+      if (idx->slots[i] == to)
+	{
+	  return true;
+	}
+      i = (i + 1) & (idx->cap - 1);
+    }
+  return false;
+}
+
+
+size_t ldigraph_index_hash(size_t to, size_t cap)
+{
+  // Fibonacci hashing spreads consecutive vertex numbers across the table
+  return (size_t)(((uint64_t)to * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (cap - 1);
+}
+
+
+void ldigraph_index_destroy(ldigraph_index *idx)
+{
+  if (idx != NULL)
+    {
+      free(idx->slots);
+      free(idx->bits);
+      free(idx);
+    }
+}
+
+
+ldigraph_workspace *ldigraph_workspace_create(size_t n)
+{
+  ldigraph_workspace *ws = malloc(sizeof(ldigraph_workspace));
+  if (ws != NULL)
+    {
+      ws->fwd = ldigraph_search_create(n);
+      ws->bwd = NULL;
+      if (ws->fwd == NULL)
+	{
+	  free(ws);
+	  return NULL;
+	}
+    }
+  return ws;
+}
+
+
+bool ldigraph_workspace_reserve(ldigraph_workspace *ws, const ldigraph *g, bool both)
+{
+  if (!ldigraph_search_reserve(ws->fwd, g->n))
+    {
+      return false;
+    }
+
+  if (both)
+    {
+      if (ws->bwd == NULL)
+	{
+	  ws->bwd = ldigraph_search_create(g->n);
+	  return ws->bwd != NULL;
+	}
+      else
+	{
+	  return ldigraph_search_reserve(ws->bwd, g->n);
+	}
+    }
+  
+  return true;
+}
+
+
+void ldigraph_workspace_destroy(ldigraph_workspace *ws)
+{
+  if (ws != NULL)
+    {
+      ldigraph_search_destroy(ws->fwd);
+      ldigraph_search_destroy(ws->bwd);
+      free(ws);
+    }
+}
+
+
+ldigraph_workspace *ldigraph_thread_workspace(size_t n)
+{
+  pthread_once(&ldigraph_thread_workspace_once, ldigraph_thread_workspace_init);
+  if (!ldigraph_thread_workspace_ready)
+    {
+      return NULL;
+    }
+
+  // the workspace grows as the queries that use it need
+  ldigraph_workspace *ws = pthread_getspecific(ldigraph_thread_workspace_key);
+  if (ws == NULL)
+    {
+      ws = ldigraph_workspace_create(n);
+      if (ws != NULL && pthread_setspecific(ldigraph_thread_workspace_key, ws) != 0)
+	{
+	  ldigraph_workspace_destroy(ws);
+	  ws = NULL;
+	}
+    }
+  return ws;
+}
+
+
+void ldigraph_thread_workspace_init(void)
+{
+  ldigraph_thread_workspace_ready = pthread_key_create(&ldigraph_thread_workspace_key, ldigraph_thread_workspace_release) == 0;
+}
+
+
+void ldigraph_thread_workspace_release(void *ws)
+{
+  ldigraph_workspace_destroy(ws);
+}
+
+
+int ldigraph_shortest_path(const ldigraph *g, size_t from, size_t to)
+{
+  if (g == NULL || from >= g->n || to >= g->n)
+    {
+      return -1;
+    }
+
+  ldigraph_workspace *ws = ldigraph_thread_workspace(g->n);
+  return ldigraph_shortest_path_with(g, from, to, ws);
+}
+
+
+int ldigraph_shortest_path_with(const ldigraph *g, size_t from, size_t to, ldigraph_workspace *ws)
+{
+  if (g == NULL || ws == NULL || from >= g->n || to >= g->n || ldigraph_reach_excluded(g, from, to))
+    {
+      return -1;
+    }
+  else if (g->labels[LDIGRAPH_LABEL_OUT] != NULL)
+    {
+      return ldigraph_labels_distance(g, from, to);
+    }
+
+  // engines that walk edges backwards need in-edges; without them
+  // everything falls back to plain BFS
+  ldigraph_shortest_engine engine = g->engine;
+  if (!ldigraph_has_in_edges(g))
+    {
+      engine = LDIGRAPH_SHORTEST_BFS;
+    }
+  else if (engine == LDIGRAPH_SHORTEST_AUTO || (engine == LDIGRAPH_SHORTEST_ALT && g->landmark_dist == NULL))
+    {
+      engine = LDIGRAPH_SHORTEST_BIDIRECTIONAL;
+    }
+  
+  bool both = engine == LDIGRAPH_SHORTEST_BIDIRECTIONAL;
+  if (!ldigraph_workspace_reserve(ws, g, both))
+    {
+      return -1;
+    }
+  
+  if (both)
+    {
+      // search from both ends
+      return ldigraph_bidirectional_bfs(g, ws, from, to);
+    }
+  else if (engine == LDIGRAPH_SHORTEST_DIRECTION_OPTIMIZING)
+    {
+      ldigraph_bfs_direction_optimizing(g, ws->fwd, from, to);
+      return ldigraph_search_dist(ws->fwd, to);
+    }
+  else if (engine == LDIGRAPH_SHORTEST_ALT)
+    {
+      return ldigraph_alt_search(g, ws->fwd, from, to);
+    }
+  
+  // do BFS starting from the from vertex, stopping once it reaches to
+  ldigraph_bfs(g, ws->fwd, from, &to, 1);
+
+  // look up the distance to the to vertex in the result and return it
+  return ldigraph_search_dist(ws->fwd, to);
+}
+
+
+bool ldigraph_shortest_paths_from(const ldigraph *g, size_t from, const size_t *targets, size_t target_count, int *lengths, ldigraph_workspace *ws)
+{
+  if (g == NULL || ws == NULL || from >= g->n || (target_count > 0 && (targets == NULL || lengths == NULL))
+      || !ldigraph_workspace_reserve(ws, g, false))
+    {
+      return false;
+    }
+
+  for (size_t i = 0; i < target_count; i++)
+    {
+      if (targets[i] >= g->n)
+	{
+	  return false;
+	}
+    }
+
+  if (g->labels[LDIGRAPH_LABEL_OUT] != NULL)
+    {
+      for (size_t i = 0; i < target_count; i++)
+	{
+	  lengths[i] = ldigraph_labels_distance(g, from, targets[i]);
+	}
+      return true;
+    }
+  
+  ldigraph_bfs(g, ws->fwd, from, targets, target_count);
+  for (size_t i = 0; i < target_count; i++)
+    {
+      lengths[i] = ldigraph_search_dist(ws->fwd, targets[i]);
+    }
+
+  return true;
+}
+
+
+bool ldigraph_distances_from(const ldigraph *g, size_t from, int *dist)
+{
+  if (g == NULL || from >= g->n || dist == NULL)
+    {
+      return false;
+    }
+
+  if (g->threads > 1)
+    {
+      return ldigraph_distances_parallel(g, from, dist, g->threads);
+    }
+  
+  ldigraph_search *s = ldigraph_search_create(g->n);
+  if (s == NULL)
+    {
+      return false;
+    }
+
+  // every level of a full search is worth considering bottom-up
+  if (ldigraph_has_in_edges(g) && g->engine != LDIGRAPH_SHORTEST_BFS)
+    {
+      ldigraph_bfs_direction_optimizing(g, s, from, LDIGRAPH_VERTEX_MAX);
+    }
+  else
+    {
+      ldigraph_bfs(g, s, from, NULL, 0);
+    }
+
+  for (size_t v = 0; v < g->n; v++)
+    {
+      dist[v] = ldigraph_search_dist(s, v);
+    }
+  
+  ldigraph_search_destroy(s);
+  return true;
+}
+
+
+bool ldigraph_distances_parallel(const ldigraph *g, size_t from, int *dist, size_t threads)
+{
+  if (g == NULL || from >= g->n || dist == NULL)
+    {
+      return false;
+    }
+
+  if (threads < 1)
+    {
+      threads = 1;
+    }
+  
+  ldigraph_parallel_bfs bfs;
+  bfs.g = g;
+  bfs.threads = threads;
+  bfs.dist = malloc(sizeof(atomic_int) * g->n);
+  bfs.frontier = malloc(sizeof(ldigraph_vertex) * g->n);
+  bfs.local = calloc(threads, sizeof(ldigraph_vertex *));
+  bfs.local_size = malloc(sizeof(size_t) * threads);
+  bfs.local_cap = calloc(threads, sizeof(size_t));
+  bfs.local_start = malloc(sizeof(size_t) * threads);
+  ldigraph_parallel_worker *workers = malloc(sizeof(ldigraph_parallel_worker) * threads);
+  pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+
+  bool ok = (bfs.dist != NULL && bfs.frontier != NULL && bfs.local != NULL && bfs.local_size != NULL
+	     && bfs.local_cap != NULL && bfs.local_start != NULL && workers != NULL && ids != NULL);
+
+  if (ok)
+    {
+      for (size_t v = 0; v < g->n; v++)
+	{
+	  atomic_init(&bfs.dist[v], -1);
+	}
+      atomic_init(&bfs.dist[from], 0);
+      bfs.frontier[0] = from;
+      bfs.frontier_size = 1;
+      bfs.level = 0;
+      atomic_init(&bfs.next_chunk, 0);
+      atomic_init(&bfs.failed, false);
+
+      pthread_mutex_init(&bfs.lock, NULL);
+      pthread_cond_init(&bfs.start, NULL);
+      bfs.ready = false;
+      
+      // the calling thread is worker 0; the others wait until we know
+      // how many of them could be started
+      size_t started = 1;
+      for (size_t t = 0; t < threads; t++)
+	{
+	  workers[t].bfs = &bfs;
+	  workers[t].id = t;
+	}
+      while (started < threads
+	     && pthread_create(&ids[started], NULL, ldigraph_parallel_bfs_worker, &workers[started]) == 0)
+	{
+	  started++;
+	}
+
+      // carry on with however many threads we got
+      bfs.threads = started;
+      bool barrier = pthread_barrier_init(&bfs.barrier, NULL, started) == 0;
+      if (!barrier)
+	{
+	  atomic_store(&bfs.failed, true);
+	}
+      pthread_mutex_lock(&bfs.lock);
+      bfs.ready = true;
+      pthread_cond_broadcast(&bfs.start);
+      pthread_mutex_unlock(&bfs.lock);
+
+      if (barrier)
+	{
+	  ldigraph_parallel_bfs_worker(&workers[0]);
+	}
+      
+      for (size_t t = 1; t < started; t++)
+	{
+	  pthread_join(ids[t], NULL);
+	}
+      if (barrier)
+	{
+	  pthread_barrier_destroy(&bfs.barrier);
+	}
+      pthread_cond_destroy(&bfs.start);
+      pthread_mutex_destroy(&bfs.lock);
+
+      ok = ok && !atomic_load(&bfs.failed);
+      if (ok)
+	{
+	  for (size_t v = 0; v < g->n; v++)
+	    {
+	      dist[v] = atomic_load_explicit(&bfs.dist[v], memory_order_relaxed);
+	    }
+	}
+    }
+
+  if (bfs.local != NULL)
+    {
+      for (size_t t = 0; t < threads; t++)
+	{
+	  free(bfs.local[t]);
+	}
+    }
+  free(bfs.dist);
+  free(bfs.frontier);
+  free(bfs.local);
+  free(bfs.local_size);
+  free(bfs.local_cap);
+  free(bfs.local_start);
+  free(workers);
+  free(ids);
+  
+  return ok;
+}
+
+
+void *ldigraph_parallel_bfs_worker(void *arg)
+{
+  ldigraph_parallel_worker *worker = arg;
+  ldigraph_parallel_bfs *bfs = worker->bfs;
+  const ldigraph *g = bfs->g;
+  size_t id = worker->id;
+
+  if (id > 0)
+    {
+      pthread_mutex_lock(&bfs->lock);
+      while (!bfs->ready)
+	{
+	  pthread_cond_wait(&bfs->start, &bfs->lock);
+	}
+      pthread_mutex_unlock(&bfs->lock);
+      if (atomic_load(&bfs->failed))
+	{
+	  return NULL;
+	}
+    }
+  
+  while (true)
+    {
+      // expand claimed chunks of the frontier into this thread's buffer
+      bfs->local_size[id] = 0;
+      size_t start;
+      while ((start = atomic_fetch_add(&bfs->next_chunk, LDIGRAPH_PARALLEL_CHUNK)) < bfs->frontier_size)
+	{
+	  size_t end = start + LDIGRAPH_PARALLEL_CHUNK;
+	  if (end > bfs->frontier_size)
+	    {
+	      end = bfs->frontier_size;
+	    }
+	  
+	  for (size_t i = start; i < end; i++)
+	    {
+	      ldigraph_cursor edges;
+	      size_t count = ldigraph_out_edges(g, bfs->frontier[i], &edges);
+	      for (size_t j = 0; j < count; j++)
+		{
+		  size_t to = ldigraph_cursor_next(&edges);
+		  int unseen = -1;
+
+		  // check before trying to claim to keep the cache line shared
+		  if (atomic_load_explicit(&bfs->dist[to], memory_order_relaxed) == -1
+		      && atomic_compare_exchange_strong_explicit(&bfs->dist[to], &unseen, bfs->level + 1,
+								 memory_order_relaxed, memory_order_relaxed))
+		    {
+		      if (bfs->local_size[id] == bfs->local_cap[id])
+			{
+			  size_t cap = bfs->local_cap[id] > 0 ? bfs->local_cap[id] * 2 : LDIGRAPH_PARALLEL_CHUNK;
+			  ldigraph_vertex *bigger = realloc(bfs->local[id], sizeof(ldigraph_vertex) * cap);
+			  if (bigger == NULL)
+			    {
+			      atomic_store(&bfs->failed, true);
+			      continue;
+			    }
+			  bfs->local[id] = bigger;
+			  bfs->local_cap[id] = cap;
+			}
+		      bfs->local[id][bfs->local_size[id]++] = to;
+		    }
+		}
+	    }
+	}
+      pthread_barrier_wait(&bfs->barrier);
+
+      // one thread lays out the next frontier
+      if (id == 0)
+	{
+	  size_t total = 0;
+	  for (size_t t = 0; t < bfs->threads; t++)
+	    {
+	      bfs->local_start[t] = total;
+	      total += bfs->local_size[t];
+	    }
+	  bfs->frontier_size = total;
+	  atomic_store(&bfs->next_chunk, 0);
+	  bfs->level++;
+	}
+      pthread_barrier_wait(&bfs->barrier);
+
+      // everyone copies their part
+      for (size_t i = 0; i < bfs->local_size[id]; i++)
+	{
+	  bfs->frontier[bfs->local_start[id] + i] = bfs->local[id][i];
+	}
+      pthread_barrier_wait(&bfs->barrier);
+
+      if (bfs->frontier_size == 0 || atomic_load(&bfs->failed))
+	{
+	  return NULL;
+	}
+    }
+}
+
+
+void ldigraph_set_threads(ldigraph *g, size_t threads)
+{
+  if (g != NULL)
+    {
+      g->threads = threads > 0 ? threads : 1;
+    }
+}
+
+
+size_t ldigraph_get_threads(const ldigraph *g)
+{
+  return g != NULL ? g->threads : 1;
+}
+
+
+bool ldigraph_shortest_paths_batch(const ldigraph *g, const size_t *from, const size_t *to, size_t count, int *lengths, ldigraph_workspace *ws)
+{
+  if (g == NULL || ws == NULL || (count > 0 && (from == NULL || to == NULL || lengths == NULL))
+      || !ldigraph_workspace_reserve(ws, g, false))
+    {
+      return false;
+    }
+  else if (g->labels[LDIGRAPH_LABEL_OUT] != NULL)
+    {
+      // each answer is a merge of two labels, with nothing to share
+      for (size_t i = 0; i < count; i++)
+	{
+	  lengths[i] = from[i] < g->n && to[i] < g->n ? ldigraph_labels_distance(g, from[i], to[i]) : -1;
+	}
+      return true;
+    }
+
+  // sort the valid queries so the ones from each start vertex are together
+  ldigraph_query_ref *refs = malloc(sizeof(ldigraph_query_ref) * (count > 0 ? count : 1));
+  size_t *targets = malloc(sizeof(size_t) * (count > 0 ? count : 1));
+  uint64_t *masks = malloc(sizeof(uint64_t) * 3 * g->n);
+  ldigraph_vertex *lists = malloc(sizeof(ldigraph_vertex) * 2 * g->n);
+  if (refs == NULL || targets == NULL || masks == NULL || lists == NULL)
+    {
+      free(refs);
+      free(targets);
+      free(masks);
+      free(lists);
+      return false;
+    }
+
+  size_t ref_count = 0;
+  for (size_t i = 0; i < count; i++)
+    {
+      lengths[i] = -1;
+      if (from[i] < g->n && to[i] < g->n)
+	{
+	  refs[ref_count].from = from[i];
+	  refs[ref_count].to = to[i];
+	  refs[ref_count].query = i;
+	  ref_count++;
+	}
+    }
+  qsort(refs, ref_count, sizeof(ldigraph_query_ref), ldigraph_query_ref_compare);
+
+  // answer the queries in chunks with up to LDIGRAPH_MSBFS_WIDTH
+  // distinct start vertices each
+  size_t start = 0;
+  while (start < ref_count)
+    {
+      size_t end = start;
+      int sources = 0;
+      while (end < ref_count
+	     && (end == start || refs[end].from == refs[end - 1].from || sources < LDIGRAPH_MSBFS_WIDTH))
+	{
+	  if (end == start || refs[end].from != refs[end - 1].from)
+	    {
+	      sources++;
+	    }
+	  refs[end].bit = sources - 1;
+	  end++;
+	}
+
+      if (sources == 1)
+	{
+	  // nothing to share, so use a search that can stop early
+	  for (size_t i = start; i < end; i++)
+	    {
+	      targets[i - start] = refs[i].to;
+	    }
+	  ldigraph_bfs(g, ws->fwd, refs[start].from, targets, end - start);
+	  for (size_t i = start; i < end; i++)
+	    {
+	      lengths[refs[i].query] = ldigraph_search_dist(ws->fwd, refs[i].to);
+	    }
+	}
+      else
+	{
+	  ldigraph_multi_source_bfs(g, refs + start, end - start, lengths, masks, lists, ws->fwd);
+	}
+
+      start = end;
+    }
+
+  free(refs);
+  free(targets);
+  free(masks);
+  free(lists);
+  return true;
+}
+
+
+void ldigraph_multi_source_bfs(const ldigraph *g, const ldigraph_query_ref *refs, size_t ref_count, int *lengths, uint64_t *masks, ldigraph_vertex *lists, ldigraph_search *s)
+{
+  uint64_t *seen = masks;
+  uint64_t *frontier = masks + g->n;
+  uint64_t *next = masks + 2 * g->n;
+  for (size_t v = 0; v < 3 * g->n; v++)
+    {
+      masks[v] = 0;
+    }
+
+  // the vertices with a nonzero frontier mask and next mask
+  ldigraph_vertex *frontier_list = lists;
+  ldigraph_vertex *next_list = lists + g->n;
+  size_t frontier_count = 0;
+  for (size_t i = 0; i < ref_count; i++)
+    {
+      if (frontier[refs[i].from] == 0)
+	{
+	  frontier_list[frontier_count++] = refs[i].from;
+	}
+      seen[refs[i].from] |= (uint64_t)1 << refs[i].bit;
+      frontier[refs[i].from] |= (uint64_t)1 << refs[i].bit;
+    }
+
+  int level = 0;
+  size_t unanswered = ref_count;
+  while (frontier_count > 0)
+    {
+      // answer the queries whose search has just reached their end
+      for (size_t i = 0; i < ref_count; i++)
+	{
+	  if (lengths[refs[i].query] == -1 && ((seen[refs[i].to] >> refs[i].bit) & 1))
+	    {
+	      lengths[refs[i].query] = level;
+	      unanswered--;
+	    }
+	}
+
+      if (unanswered == 0)
+	{
+	  break;
+	}
+      
+      // push every search along the edges out of its frontier; a
+      // vertex's searches share one pass over its adjacency list
+      size_t next_count = 0;
+      for (size_t i = 0; i < frontier_count; i++)
+	{
+	  size_t v = frontier_list[i];
+	  ldigraph_cursor edges;
+	  size_t count = ldigraph_out_edges(g, v, &edges);
+	  s->vertices_scanned++;
+	  s->edges_scanned += count;
+	      
+	  for (size_t j = 0; j < count; j++)
+	    {
+	      size_t w = ldigraph_cursor_next(&edges);
+	      uint64_t arriving = frontier[v] & ~seen[w];
+	      if (arriving != 0)
+		{
+		  if (next[w] == 0)
+		    {
+		      next_list[next_count++] = w;
+		    }
+		  next[w] |= arriving;
+		}
+	    }
+	}
+
+      // the next frontier is whatever each vertex was first reached by
+      for (size_t i = 0; i < frontier_count; i++)
+	{
+	  frontier[frontier_list[i]] = 0;
+	}
+      for (size_t i = 0; i < next_count; i++)
+	{
+	  size_t w = next_list[i];
+	  frontier[w] = next[w];
+	  seen[w] |= next[w];
+	  next[w] = 0;
+	}
+
+      ldigraph_vertex *temp = frontier_list;
+      frontier_list = next_list;
+      next_list = temp;
+      frontier_count = next_count;
+      level++;
+    }
+}
+
+
+int ldigraph_query_ref_compare(const void *a, const void *b)
+{
+  const ldigraph_query_ref *r1 = a;
+  const ldigraph_query_ref *r2 = b;
+  if (r1->from != r2->from)
+    {
+      return r1->from < r2->from ? -1 : 1;
+    }
+  else
+    {
+      return r1->query < r2->query ? -1 : (r1->query > r2->query ? 1 : 0);
+    }
+}
+
+
+void ldigraph_set_shortest_engine(ldigraph *g, ldigraph_shortest_engine engine)
+{
+  if (g != NULL)
+    {
+      g->engine = engine;
+    }
+}
+
+
+ldigraph_shortest_engine ldigraph_get_shortest_engine(const ldigraph *g)
+{
+  return g != NULL ? g->engine : LDIGRAPH_SHORTEST_AUTO;
+}
+
+
+ldigraph_search_stats ldigraph_workspace_stats(const ldigraph_workspace *ws)
+{
+  ldigraph_search_stats stats = {0, 0};
+  if (ws != NULL)
+    {
+      stats.vertices = ws->fwd->vertices_scanned;
+      stats.edges = ws->fwd->edges_scanned;
+      if (ws->bwd != NULL)
+	{
+	  stats.vertices += ws->bwd->vertices_scanned;
+	  stats.edges += ws->bwd->edges_scanned;
+	}
+    }
+  return stats;
+}
+
+
+void ldigraph_workspace_reset_stats(ldigraph_workspace *ws)
+{
+  if (ws != NULL)
+    {
+      ws->fwd->vertices_scanned = 0;
+      ws->fwd->edges_scanned = 0;
+      if (ws->bwd != NULL)
+	{
+	  ws->bwd->vertices_scanned = 0;
+	  ws->bwd->edges_scanned = 0;
+	}
+    }
+}
+
+
+void ldigraph_bfs(const ldigraph *g, ldigraph_search *s, size_t from, const size_t *targets, size_t target_count)
+{
+  ldigraph_search_init(s, g);
+
+  // count the distinct targets other than from, which is reached at once
+  size_t remaining = 0;
+  for (size_t i = 0; i < target_count; i++)
+    {
+      if (targets[i] != from && ldigraph_search_mark_target(s, targets[i]))
+	{
+	  remaining++;
+	}
+    }
+  bool early_exit = targets != NULL;
+  
+  // each vertex is enqueued at most once, so a plain array will do
+  ldigraph_vertex *queue = s->queue;
+  size_t head = 0;
+  size_t tail = 0;
+  queue[tail++] = from;
+  ldigraph_search_reach(s, from, 0, LDIGRAPH_VERTEX_MAX);
+
+  while (head < tail && (!early_exit || remaining > 0))
+    {
+      size_t curr = queue[head++];
+      
+      ldigraph_cursor edges;
+      size_t count = ldigraph_out_edges(g, curr, &edges);
+      s->vertices_scanned++;
+      
+      size_t i;
+      for (i = 0; i < count && (!early_exit || remaining > 0); i++)
+	{
+	  size_t to = ldigraph_cursor_next(&edges);
+	  if (ldigraph_search_color(s, to) == LDIGRAPH_UNSEEN)
+	    {
+	      if (early_exit && ldigraph_search_is_target(s, to))
+		{
+		  remaining--;
+		}
+	      
+	      ldigraph_search_reach(s, to, s->dist[curr] + 1, curr);
+	      queue[tail++] = to;
+	    }
+	}
+      s->edges_scanned += i;
+
+      s->color[curr] = LDIGRAPH_DONE;
+    }
+}
+
+
+void ldigraph_bfs_direction_optimizing(const ldigraph *g, ldigraph_search *s, size_t from, size_t target)
+{
+  ldigraph_search_init(s, g);
+  
+  size_t words = (g->n + 63) / 64;
+  ldigraph_vertex *queue = s->queue;
+  size_t head = 0;
+  size_t tail = 0;
+  queue[tail++] = from;
+  ldigraph_search_reach(s, from, 0, LDIGRAPH_VERTEX_MAX);
+  
+  // edges out of the frontier and out of unseen vertices, which estimate
+  // the work of expanding the next level top-down and bottom-up
+  size_t frontier_edges = ldigraph_out_degree(g, from);
+  size_t edges_unexplored = g->m - frontier_edges;
+  
+  int level = 0;
+  bool reached = from == target;
+  while (head < tail && !reached)
+    {
+      if (frontier_edges > edges_unexplored / LDIGRAPH_BFS_ALPHA)
+	{
+	  // move the frontier from the queue to a bitmap
+	  for (size_t w = 0; w < words; w++)
+	    {
+	      s->frontier[w] = 0;
+	    }
+	  for (size_t i = head; i < tail; i++)
+	    {
+	      s->frontier[queue[i] / 64] |= (uint64_t)1 << (queue[i] % 64);
+	    }
+
+	  // go bottom-up until the frontier is small and shrinking
+	  size_t awake = tail - head;
+	  size_t prev_awake;
+	  do
+	    {
+	      prev_awake = awake;
+	      awake = ldigraph_bfs_bottom_up_step(g, s, level, target, &edges_unexplored);
+	      level++;
+	      
+	      uint64_t *temp = s->frontier;
+	      s->frontier = s->next;
+	      s->next = temp;
+
+	      reached = target != LDIGRAPH_VERTEX_MAX && ldigraph_search_color(s, target) != LDIGRAPH_UNSEEN;
+	    } while (!reached && awake > 0 && (awake >= prev_awake || awake > g->n / LDIGRAPH_BFS_BETA));
+
+	  // move the frontier back to the queue; the queue can start over
+	  // since none of these vertices has been in it
+	  head = 0;
+	  tail = 0;
+	  frontier_edges = 0;
+	  for (size_t w = 0; w < words; w++)
+	    {
+	      uint64_t bits = s->frontier[w];
+	      while (bits != 0)
+		{
+		  size_t v = w * 64 + __builtin_ctzll(bits);
+		  bits &= bits - 1;
+		  queue[tail++] = v;
+		  frontier_edges += ldigraph_out_degree(g, v);
+		}
+	    }
+	}
+      else
+	{
+	  // expand one level top-down
+	  size_t level_end = tail;
+	  frontier_edges = 0;
+	  while (head < level_end && !reached)
+	    {
+	      size_t curr = queue[head++];
+	      
+	      ldigraph_cursor edges;
+	      size_t count = ldigraph_out_edges(g, curr, &edges);
+	      s->vertices_scanned++;
+	      
+	      size_t i;
+	      for (i = 0; i < count && !reached; i++)
+		{
+		  size_t to = ldigraph_cursor_next(&edges);
+		  if (ldigraph_search_color(s, to) == LDIGRAPH_UNSEEN)
+		    {
+		      ldigraph_search_reach(s, to, level + 1, curr);
+		      queue[tail++] = to;
+
+		      size_t degree = ldigraph_out_degree(g, to);
+		      frontier_edges += degree;
+		      edges_unexplored -= degree;
+		      reached = to == target;
+		    }
+		}
+	      s->edges_scanned += i;
+	      
+	      s->color[curr] = LDIGRAPH_DONE;
+	    }
+	  level++;
+	}
+    }
+}
+
+
+size_t ldigraph_bfs_bottom_up_step(const ldigraph *g, ldigraph_search *s, int level, size_t target, size_t *edges_unexplored)
+{
+  size_t words = (g->n + 63) / 64;
+  for (size_t w = 0; w < words; w++)
+    {
+      s->next[w] = 0;
+    }
+
+  size_t awake = 0;
+  for (size_t v = 0; v < g->n; v++)
+    {
+      if (ldigraph_search_color(s, v) == LDIGRAPH_UNSEEN)
+	{
+	  ldigraph_cursor edges;
+	  size_t count = ldigraph_in_edges(g, v, &edges);
+	  s->vertices_scanned++;
+
+	  // one in-edge from the frontier is enough, so stop at the first
+	  size_t i = 0;
+	  size_t source = v;
+	  while (i < count)
+	    {
+	      source = ldigraph_cursor_next(&edges);
+	      if ((s->frontier[source / 64] >> (source % 64)) & 1)
+		{
+		  break;
+		}
+	      i++;
+	    }
+	  s->edges_scanned += i < count ? i + 1 : count;
+	  
+	  if (i < count)
+	    {
+	      ldigraph_search_reach(s, v, level + 1, source);
+	      s->next[v / 64] |= (uint64_t)1 << (v % 64);
+	      *edges_unexplored -= ldigraph_out_degree(g, v);
+	      awake++;
+
+	      if (v == target)
+		{
+		  break;
+		}
+	    }
+	}
+    }
+
+  return awake;
+}
+
+
+int ldigraph_bidirectional_bfs(const ldigraph *g, ldigraph_workspace *ws, size_t from, size_t to)
+{
+  if (from == to)
+    {
+      return 0;
+    }
+
+  // one search going forward from from and one going backward from to
+  ldigraph_search *fwd = ws->fwd;
+  ldigraph_search *bwd = ws->bwd;
+  ldigraph_search_init(fwd, g);
+  ldigraph_search_init(bwd, g);
+
+  size_t fwd_head = 0;
+  size_t fwd_tail = 0;
+  fwd->queue[fwd_tail++] = from;
+  ldigraph_search_reach(fwd, from, 0, LDIGRAPH_VERTEX_MAX);
+  
+  size_t bwd_head = 0;
+  size_t bwd_tail = 0;
+  bwd->queue[bwd_tail++] = to;
+  ldigraph_search_reach(bwd, to, 0, LDIGRAPH_VERTEX_MAX);
+
+  // Each side only ever stops partway through a level when the searches
+  // meet, so the other side has always finished every level it started.
+  // If neither side had reached a common vertex when this level started,
+  // then every meeting found while expanding it gives the same length,
+  // which is the shortest, so we can stop at the first one.
+  int shortest = -1;
+  while (shortest == -1 && fwd_head < fwd_tail && bwd_head < bwd_tail)
+    {
+      bool forward = fwd_tail - fwd_head <= bwd_tail - bwd_head;
+      ldigraph_search *s = forward ? fwd : bwd;
+      const ldigraph_search *other = forward ? bwd : fwd;
+      size_t *head = forward ? &fwd_head : &bwd_head;
+      size_t *tail = forward ? &fwd_tail : &bwd_tail;
+
+      size_t level_end = *tail;
+      while (shortest == -1 && *head < level_end)
+	{
+	  size_t curr = s->queue[(*head)++];
+
+	  ldigraph_cursor edges;
+	  size_t count = (forward
+			  ? ldigraph_out_edges(g, curr, &edges)
+			  : ldigraph_in_edges(g, curr, &edges));
+	  s->vertices_scanned++;
+	  
+	  size_t i;
+	  for (i = 0; shortest == -1 && i < count; i++)
+	    {
+	      size_t next = ldigraph_cursor_next(&edges);
+	      if (ldigraph_search_color(s, next) == LDIGRAPH_UNSEEN)
+		{
+		  ldigraph_search_reach(s, next, s->dist[curr] + 1, curr);
+		  s->queue[(*tail)++] = next;
+
+		  if (ldigraph_search_color(other, next) != LDIGRAPH_UNSEEN)
+		    {
+		      shortest = s->dist[next] + other->dist[next];
+		    }
+		}
+	    }
+	  s->edges_scanned += i;
+	  
+	  s->color[curr] = LDIGRAPH_DONE;
+	}
+    }
+
+  return shortest;
+}
+
+
+int ldigraph_longest_path(const ldigraph *g, size_t from, size_t to)
+{
+  if (g == NULL || from >= g->n || to >= g->n)
+    {
+      return -1;
+    }
+
+  ldigraph_workspace *ws = ldigraph_thread_workspace(g->n);
+  return ldigraph_longest_path_with(g, from, to, ws);
+}
+
+
+int ldigraph_longest_path_with(const ldigraph *g, size_t from, size_t to, ldigraph_workspace *ws)
+{
+  if (g == NULL || ws == NULL || from >= g->n || to >= g->n || ldigraph_reach_excluded(g, from, to)
+      || !ldigraph_workspace_reserve(ws, g, false))
+    {
+      return -1;
+    }
+
+  if (g->order_state == LDIGRAPH_ORDER_ACYCLIC)
+    {
+      return ldigraph_longest_path_dag(g, ws->fwd, from, to);
+    }
+  else if (!ldigraph_dfs(g, ws->fwd, from) || ldigraph_search_color(ws->fwd, to) == LDIGRAPH_UNSEEN)
+    {
+      // a plain DFS shows there are no paths to find
+      return -1;
+    }
+  else if (g->component != NULL)
+    {
+      // work through the strongly connected components
+      return ldigraph_longest_path_components(g, ws->fwd, from, to);
+    }
+
+  // the graph has not been prepared, but if the DFS met no cycle then
+  // the order it finished in gives the answer in linear time
+  bool acyclic;
+  int longest = ldigraph_longest_path_reached(g, ws->fwd, to, &acyclic);
+  if (acyclic)
+    {
+      return longest;
+    }
+  else
+    {
+      // search all of the graph
+      ldigraph_path_search *ps = ldigraph_path_search_create(g, NULL);
+      longest = ps != NULL ? ldigraph_path_search_run(ps, from, to, NULL) : -1;
+      if (ps != NULL)
+	{
+	  ws->fwd->vertices_scanned += ps->vertices_scanned;
+	  ws->fwd->edges_scanned += ps->edges_scanned;
+	}
+      ldigraph_path_search_destroy(ps);
+      return longest;
+    }
+}
+
+
+int ldigraph_longest_path_budgeted(const ldigraph *g, size_t from, size_t to, ldigraph_longest_budget budget, bool *is_exact)
+{
+  if (g == NULL || from >= g->n || to >= g->n)
+    {
+      if (is_exact != NULL)
+	{
+	  *is_exact = false;
+	}
+      return -1;
+    }
+
+  ldigraph_workspace *ws = ldigraph_thread_workspace(g->n);
+  return ldigraph_longest_path_budgeted_with(g, from, to, budget, is_exact, ws);
+}
+
+
+int ldigraph_longest_path_budgeted_with(const ldigraph *g, size_t from, size_t to, ldigraph_longest_budget budget, bool *is_exact, ldigraph_workspace *ws)
+{
+  double start = ldigraph_seconds();
+  bool exact = false;
+  int longest = -1;
+  
+  if (g == NULL || ws == NULL || from >= g->n || to >= g->n || is_exact == NULL
+      || !ldigraph_workspace_reserve(ws, g, false))
+    {
+      // nothing known
+    }
+  else if (ldigraph_reach_excluded(g, from, to))
+    {
+      exact = true;
+    }
+  else if (g->order_state == LDIGRAPH_ORDER_ACYCLIC)
+    {
+      // linear time is within any reasonable budget
+      longest = ldigraph_longest_path_dag(g, ws->fwd, from, to);
+      exact = true;
+    }
+  else if (from == to)
+    {
+      longest = 0;
+      exact = true;
+    }
+  else
+    {
+      // a breadth-first search shows whether there is a path at all, and
+      // the shortest one is the first lower bound
+      ldigraph_bfs(g, ws->fwd, from, &to, 1);
+      longest = ldigraph_search_dist(ws->fwd, to);
+      exact = longest < 0;
+      
+      ldigraph_path_search *ps = longest >= 0 ? ldigraph_path_search_create(g, NULL) : NULL;
+      size_t limit;
+      if (ps != NULL && ldigraph_path_search_prepare(ps, from, to, NULL, &limit))
+	{
+	  ldigraph_vertex root = from;
+	  atomic_int best;
+	  atomic_init(&best, longest);
+	  bool ok = true;
+
+	  // seed with a greedy dive and dives in random orders, each with
+	  // an even share of the first half of the budget
+	  for (size_t r = 0; ok && r < LDIGRAPH_APPROX_RESTARTS && atomic_load(&best) < (int)limit; r++)
+	    {
+	      ps->random = r == 0 ? 0 : 0x9E3779B97F4A7C15ULL * (r + from * LDIGRAPH_APPROX_RESTARTS + 1);
+	      ps->budget = budget.expansions > 0 ? budget.expansions / 2 / LDIGRAPH_APPROX_RESTARTS + 1 : SIZE_MAX;
+	      ps->deadline = budget.seconds > 0 ? start + budget.seconds / 2 * (r + 1) / LDIGRAPH_APPROX_RESTARTS : 0;
+	      ps->stopped = false;
+	      int length;
+	      ok = ldigraph_path_search_dive(ps, from, to, &length);
+	      ldigraph_atomic_max(&best, length);
+	    }
+
+	  // then improve on the seed with the exact search for the rest
+	  if (ok && atomic_load(&best) < (int)limit)
+	    {
+	      size_t used = ps->vertices_scanned;
+	      ps->budget = budget.expansions > 0 ? (used < budget.expansions ? budget.expansions - used : 0) : SIZE_MAX;
+	      ps->deadline = budget.seconds > 0 ? start + budget.seconds : 0;
+	      ps->stopped = false;
+	      ok = ldigraph_path_search_extend(ps, &root, 1, to, limit, &best, NULL, 0);
+	    }
+	  
+	  longest = atomic_load(&best);
+	  exact = ok && (!ps->stopped || longest == (int)limit);
+	}
+      
+      if (ps != NULL)
+	{
+	  ws->fwd->vertices_scanned += ps->vertices_scanned;
+	  ws->fwd->edges_scanned += ps->edges_scanned;
+	}
+      ldigraph_path_search_destroy(ps);
+    }
+
+  if (is_exact != NULL)
+    {
+      *is_exact = exact;
+    }
+  return longest;
+}
+
+
+bool ldigraph_prepare_longest(ldigraph *g)
+{
+  if (g == NULL || !ldigraph_freeze(g) || !ldigraph_topological_order(g))
+    {
+      return false;
+    }
+
+  // acyclic graphs only need the order
+  return g->order_state == LDIGRAPH_ORDER_ACYCLIC || ldigraph_components_build(g);
+}
+
+
+double ldigraph_seconds(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+
+bool ldigraph_build_reachability(ldigraph *g)
+{
+  if (g == NULL || !ldigraph_freeze(g) || !ldigraph_components_build(g))
+    {
+      return false;
+    }
+  else if (g->reach_low != NULL)
+    {
+      return true;
+    }
+
+  // the condensation, with an edge for every edge between components
+  size_t count = g->components;
+  size_t *offset = calloc(count + 1, sizeof(size_t));
+  size_t m = g->m;
+  ldigraph_vertex *edges = malloc(sizeof(ldigraph_vertex) * (m > 0 ? m : 1));
+  ldigraph_vertex *low = malloc(sizeof(ldigraph_vertex) * LDIGRAPH_REACH_LABELS * (count > 0 ? count : 1));
+  ldigraph_vertex *post = malloc(sizeof(ldigraph_vertex) * LDIGRAPH_REACH_LABELS * (count > 0 ? count : 1));
+  ldigraph_dfs_frame *stack = malloc(sizeof(ldigraph_dfs_frame) * (count > 0 ? count : 1));
+  if (offset == NULL || edges == NULL || low == NULL || post == NULL || stack == NULL)
+    {
+      free(offset);
+      free(edges);
+      free(low);
+      free(post);
+      free(stack);
+      return false;
+    }
+
+  // counting sort of the edges by source component, as in
+  // ldigraph_build_in_edges
+  for (size_t u = 0; u < g->n; u++)
+    {
+      ldigraph_cursor out;
+      size_t degree = ldigraph_out_edges(g, u, &out);
+      for (size_t i = 0; i < degree; i++)
+	{
+	  if (g->component[ldigraph_cursor_next(&out)] != g->component[u])
+	    {
+	      offset[g->component[u]]++;
+	    }
+	}
+    }
+
+  size_t start = 0;
+  for (size_t c = 0; c < count; c++)
+    {
+      size_t edges_out = offset[c];
+      offset[c] = start;
+      start += edges_out;
+    }
+
+  for (size_t u = 0; u < g->n; u++)
+    {
+      ldigraph_cursor out;
+      size_t degree = ldigraph_out_edges(g, u, &out);
+      for (size_t i = 0; i < degree; i++)
+	{
+	  size_t c = g->component[u];
+	  size_t d = g->component[ldigraph_cursor_next(&out)];
+	  if (c != d)
+	    {
+	      edges[offset[c]++] = d;
+	    }
+	}
+    }
+
+  for (size_t c = count; c > 0; c--)
+    {
+      offset[c] = offset[c - 1];
+    }
+  offset[0] = 0;
+  
+  // one DFS of the condensation per label, each visiting roots and
+  // children in a different order; a component's label is the interval
+  // from the smallest post-order number below it to its own
+  for (size_t l = 0; l < LDIGRAPH_REACH_LABELS; l++)
+    {
+      ldigraph_vertex *l_low = low + l * count;
+      ldigraph_vertex *l_post = post + l * count;
+      bool reverse = l % 2 == 1;
+      for (size_t c = 0; c < count; c++)
+	{
+	  l_post[c] = LDIGRAPH_VERTEX_MAX;
+	}
+
+      size_t finished = 0;
+      for (size_t r = 0; r < count; r++)
+	{
+	  size_t root = reverse ? count - 1 - r : r;
+	  if (l_post[root] != LDIGRAPH_VERTEX_MAX)
+	    {
+	      continue;
+	    }
+
+	  // components being visited are marked with a post-order number
+	  // no finished one can have
+	  l_post[root] = LDIGRAPH_VERTEX_MAX - 1;
+	  stack[0].vertex = root;
+	  stack[0].next = 0;
+	  size_t depth = 1;
+	  while (depth > 0)
+	    {
+	      ldigraph_dfs_frame *top = &stack[depth - 1];
+	      size_t c = top->vertex;
+	      size_t degree = offset[c + 1] - offset[c];
+	      if (top->next < degree)
+		{
+		  size_t i = top->next++;
+		  size_t d = edges[reverse ? offset[c + 1] - 1 - i : offset[c] + i];
+		  if (l_post[d] == LDIGRAPH_VERTEX_MAX)
+		    {
+		      l_post[d] = LDIGRAPH_VERTEX_MAX - 1;
+		      stack[depth].vertex = d;
+		      stack[depth].next = 0;
+		      depth++;
+		    }
+		}
+	      else
+		{
+		  // every component below c is finished
+		  l_post[c] = finished++;
+		  l_low[c] = l_post[c];
+		  for (size_t e = offset[c]; e < offset[c + 1]; e++)
+		    {
+		      if (l_low[edges[e]] < l_low[c])
+			{
+			  l_low[c] = l_low[edges[e]];
+			}
+		    }
+		  depth--;
+		}
+	    }
+	}
+    }
+
+  free(offset);
+  free(edges);
+  free(stack);
+  g->reach_low = low;
+  g->reach_post = post;
+  return true;
+}
+
+
+bool ldigraph_reachable(const ldigraph *g, size_t from, size_t to)
+{
+  if (g == NULL || from >= g->n || to >= g->n)
+    {
+      return false;
+    }
+
+  ldigraph_workspace *ws = ldigraph_thread_workspace(g->n);
+  return ldigraph_reachable_with(g, from, to, ws);
+}
+
+
+bool ldigraph_reachable_with(const ldigraph *g, size_t from, size_t to, ldigraph_workspace *ws)
+{
+  if (g == NULL || ws == NULL || from >= g->n || to >= g->n)
+    {
+      return false;
+    }
+  else if (from == to || (g->reach_low != NULL && g->component[from] == g->component[to]))
+    {
+      return true;
+    }
+  else if (ldigraph_reach_excluded(g, from, to) || !ldigraph_workspace_reserve(ws, g, false))
+    {
+      return false;
+    }
+
+  // DFS that stops at to and skips vertices the labels rule out
+  ldigraph_search *s = ws->fwd;
+  ldigraph_search_init(s, g);
+  if (!ldigraph_search_reserve_stack(s, 1))
+    {
+      return false;
+    }
+  ldigraph_search_reach(s, from, 0, LDIGRAPH_VERTEX_MAX);
+  s->stack[0].vertex = from;
+  s->stack[0].next = 0;
+  ldigraph_out_edges(g, from, &s->stack[0].edges);
+  size_t depth = 1;
+  while (depth > 0)
+    {
+      ldigraph_dfs_frame *top = &s->stack[depth - 1];
+      size_t count = ldigraph_out_degree(g, top->vertex);
+      if (top->next == 0)
+	{
+	  s->vertices_scanned++;
+	  s->edges_scanned += count;
+	}
+      
+      if (top->next < count)
+	{
+	  size_t next = ldigraph_cursor_next(&top->edges);
+	  top->next++;
+	  if (next == to)
+	    {
+	      return true;
+	    }
+	  else if (ldigraph_search_color(s, next) == LDIGRAPH_UNSEEN && !ldigraph_reach_excluded(g, next, to))
+	    {
+	      ldigraph_search_reach(s, next, s->dist[top->vertex] + 1, top->vertex);
+	      if (!ldigraph_search_reserve_stack(s, depth + 1))
+		{
+		  return false;
+		}
+	      s->stack[depth].vertex = next;
+	      s->stack[depth].next = 0;
+	      ldigraph_out_edges(g, next, &s->stack[depth].edges);
+	      depth++;
+	    }
+	}
+      else
+	{
+	  depth--;
+	}
+    }
+
+  return false;
+}
+
+
+bool ldigraph_reach_excluded(const ldigraph *g, size_t from, size_t to)
+{
+  if (g->reach_low == NULL)
+    {
+      return false;
+    }
+
+  // edges between components only go forward in their order, and a
+  // component's labels contain those of everything it reaches
+  size_t c = g->component[from];
+  size_t d = g->component[to];
+  if (c == d)
+    {
+      return false;
+    }
+  else if (c > d)
+    {
+      return true;
+    }
+  
+  for (size_t l = 0; l < LDIGRAPH_REACH_LABELS; l++)
+    {
+      size_t i = l * g->components;
+      if (g->reach_low[i + d] < g->reach_low[i + c] || g->reach_post[i + d] > g->reach_post[i + c])
+	{
+	  return true;
+	}
+    }
+  return false;
+}
+
+
+bool ldigraph_build_labels(ldigraph *g)
+{
+  if (g == NULL || !ldigraph_build_in_edges(g))
+    {
+      return false;
+    }
+  else if (g->labels[LDIGRAPH_LABEL_OUT] != NULL)
+    {
+      return true;
+    }
+
+  size_t threads = g->threads < g->n ? g->threads : g->n;
+  ldigraph_labeling build;
+  build.g = g;
+  build.threads = threads;
+  ldigraph_vertex_key *by_degree = malloc(sizeof(ldigraph_vertex_key) * g->n);
+  ldigraph_vertex *order = malloc(sizeof(ldigraph_vertex) * g->n);
+  build.lists[LDIGRAPH_LABEL_OUT] = calloc(g->n, sizeof(ldigraph_label_list));
+  build.lists[LDIGRAPH_LABEL_IN] = calloc(g->n, sizeof(ldigraph_label_list));
+  build.workers = calloc(threads, sizeof(ldigraph_labeling_worker));
+  pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+
+  bool ok = (by_degree != NULL && order != NULL && build.lists[LDIGRAPH_LABEL_OUT] != NULL
+	     && build.lists[LDIGRAPH_LABEL_IN] != NULL && build.workers != NULL && ids != NULL);
+  for (size_t t = 0; ok && t < threads; t++)
+    {
+      ldigraph_labeling_worker *worker = &build.workers[t];
+      worker->build = &build;
+      worker->id = t;
+      worker->dist = malloc(sizeof(ldigraph_vertex) * g->n);
+      worker->queue = malloc(sizeof(ldigraph_vertex) * g->n);
+      worker->hub_dist = malloc(sizeof(ldigraph_vertex) * g->n);
+      ok = worker->dist != NULL && worker->queue != NULL && worker->hub_dist != NULL;
+      for (size_t v = 0; ok && v < g->n; v++)
+	{
+	  worker->dist[v] = LDIGRAPH_VERTEX_MAX;
+	  worker->hub_dist[v] = LDIGRAPH_VERTEX_MAX;
+	}
+    }
+
+  if (ok)
+    {
+      // hubs in decreasing order of degree, since vertices on many
+      // shortest paths prune the most later searches
+      for (size_t v = 0; v < g->n; v++)
+	{
+	  by_degree[v].vertex = v;
+	  by_degree[v].key = ldigraph_out_degree(g, v) + ldigraph_in_degree(g, v);
+	}
+      qsort(by_degree, g->n, sizeof(ldigraph_vertex_key), ldigraph_vertex_key_descending);
+      for (size_t i = 0; i < g->n; i++)
+	{
+	  order[i] = by_degree[i].vertex;
+	}
+      build.order = order;
+      build.batch = 0;
+      atomic_init(&build.failed, false);
+
+      pthread_mutex_init(&build.lock, NULL);
+      pthread_cond_init(&build.start, NULL);
+      build.ready = false;
+
+      // as in parallel BFS, the calling thread is worker 0 and the others
+      // wait until we know how many of them could be started
+      size_t started = 1;
+      while (started < threads
+	     && pthread_create(&ids[started], NULL, ldigraph_labeling_worker_run, &build.workers[started]) == 0)
+	{
+	  started++;
+	}
+
+      build.threads = started;
+      bool barrier = pthread_barrier_init(&build.barrier, NULL, started) == 0;
+      if (!barrier)
+	{
+	  atomic_store(&build.failed, true);
+	}
+      pthread_mutex_lock(&build.lock);
+      build.ready = true;
+      pthread_cond_broadcast(&build.start);
+      pthread_mutex_unlock(&build.lock);
+
+      if (barrier)
+	{
+	  ldigraph_labeling_worker_run(&build.workers[0]);
+	}
+
+      for (size_t t = 1; t < started; t++)
+	{
+	  pthread_join(ids[t], NULL);
+	}
+      if (barrier)
+	{
+	  pthread_barrier_destroy(&build.barrier);
+	}
+      pthread_cond_destroy(&build.start);
+      pthread_mutex_destroy(&build.lock);
+
+      ok = !atomic_load(&build.failed);
+    }
+
+  // pack the labels of each kind one vertex after another
+  for (int kind = 0; ok && kind < 2; kind++)
+    {
+      size_t total = 0;
+      for (size_t v = 0; v < g->n; v++)
+	{
+	  total += build.lists[kind][v].size;
+	}
+
+      g->label_offset[kind] = malloc(sizeof(size_t) * (g->n + 1));
+      g->labels[kind] = malloc(sizeof(ldigraph_label) * (total > 0 ? total : 1));
+      ok = g->label_offset[kind] != NULL && g->labels[kind] != NULL;
+      total = 0;
+      for (size_t v = 0; ok && v < g->n; v++)
+	{
+	  g->label_offset[kind][v] = total;
+	  for (size_t i = 0; i < build.lists[kind][v].size; i++)
+	    {
+	      g->labels[kind][total++] = build.lists[kind][v].entries[i];
+	    }
+	}
+      if (ok)
+	{
+	  g->label_offset[kind][g->n] = total;
+	}
+    }
+
+  if (!ok)
+    {
+      ldigraph_labels_clear(g);
+    }
+  
+  for (int kind = 0; kind < 2; kind++)
+    {
+      for (size_t v = 0; build.lists[kind] != NULL && v < g->n; v++)
+	{
+	  free(build.lists[kind][v].entries);
+	}
+      free(build.lists[kind]);
+    }
+  for (size_t t = 0; build.workers != NULL && t < threads; t++)
+    {
+      free(build.workers[t].dist);
+      free(build.workers[t].queue);
+      free(build.workers[t].hub_dist);
+      free(build.workers[t].found[LDIGRAPH_LABEL_OUT].entries);
+      free(build.workers[t].found[LDIGRAPH_LABEL_IN].entries);
+    }
+  free(build.workers);
+  free(ids);
+  free(by_degree);
+  free(order);
+
+  return ok;
+}
+
+
+void *ldigraph_labeling_worker_run(void *arg)
+{
+  ldigraph_labeling_worker *worker = arg;
+  ldigraph_labeling *build = worker->build;
+  size_t n = build->g->n;
+
+  if (worker->id > 0)
+    {
+      pthread_mutex_lock(&build->lock);
+      while (!build->ready)
+	{
+	  pthread_cond_wait(&build->start, &build->lock);
+	}
+      pthread_mutex_unlock(&build->lock);
+      if (atomic_load(&build->failed))
+	{
+	  return NULL;
+	}
+    }
+
+  while (true)
+    {
+      // each thread searches from its own hub in the batch, pruning with
+      // the labels from earlier batches only
+      size_t rank = build->batch + worker->id;
+      worker->found[LDIGRAPH_LABEL_OUT].size = 0;
+      worker->found[LDIGRAPH_LABEL_IN].size = 0;
+      if (rank < n && !atomic_load(&build->failed)
+	  && (!ldigraph_labeling_bfs(worker, rank, LDIGRAPH_LABEL_IN)
+	      || !ldigraph_labeling_bfs(worker, rank, LDIGRAPH_LABEL_OUT)))
+	{
+	  atomic_store(&build->failed, true);
+	}
+      pthread_barrier_wait(&build->barrier);
+
+      // one thread adds the batch's entries in order of rank, which keeps
+      // every label sorted
+      if (worker->id == 0)
+	{
+	  for (size_t t = 0; t < build->threads; t++)
+	    {
+	      for (int kind = 0; kind < 2; kind++)
+		{
+		  const ldigraph_label_list *found = &build->workers[t].found[kind];
+		  for (size_t i = 0; i < found->size; i++)
+		    {
+		      if (!ldigraph_label_list_add(&build->lists[kind][found->entries[i].vertex],
+						   build->batch + t, found->entries[i].dist))
+			{
+			  atomic_store(&build->failed, true);
+			}
+		    }
+		}
+	    }
+	  build->batch += build->threads;
+	}
+      pthread_barrier_wait(&build->barrier);
+
+      if (build->batch >= n || atomic_load(&build->failed))
+	{
+	  return NULL;
+	}
+    }
+}
+
+
+bool ldigraph_labeling_bfs(ldigraph_labeling_worker *worker, size_t rank, int kind)
+{
+  ldigraph_labeling *build = worker->build;
+  const ldigraph *g = build->g;
+  size_t root = build->order[rank];
+  bool forward = kind == LDIGRAPH_LABEL_IN;
+
+  // the distances between the root and the hubs it already has, in the
+  // direction that combines with kind
+  const ldigraph_label_list *root_label = &build->lists[forward ? LDIGRAPH_LABEL_OUT : LDIGRAPH_LABEL_IN][root];
+  for (size_t i = 0; i < root_label->size; i++)
+    {
+      worker->hub_dist[root_label->entries[i].vertex] = root_label->entries[i].dist;
+    }
+
+  ldigraph_label_list *found = &worker->found[kind];
+  found->size = 0;
+  bool ok = true;
+  worker->dist[root] = 0;
+  worker->queue[0] = root;
+  size_t head = 0;
+  size_t tail = 1;
+  while (ok && head < tail)
+    {
+      size_t v = worker->queue[head++];
+      size_t d = worker->dist[v];
+
+      // prune where a path through an earlier hub is as short
+      const ldigraph_label_list *label = &build->lists[kind][v];
+      bool covered = false;
+      for (size_t i = 0; !covered && i < label->size; i++)
+	{
+	  size_t hub_dist = worker->hub_dist[label->entries[i].vertex];
+	  covered = hub_dist != LDIGRAPH_VERTEX_MAX && hub_dist + label->entries[i].dist <= d;
+	}
+      if (covered)
+	{
+	  continue;
+	}
+
+      ok = ldigraph_label_list_add(found, v, d);
+      
+      ldigraph_cursor edges;
+      size_t count = forward ? ldigraph_out_edges(g, v, &edges) : ldigraph_in_edges(g, v, &edges);
+      for (size_t i = 0; i < count; i++)
+	{
+	  size_t w = ldigraph_cursor_next(&edges);
+	  if (worker->dist[w] == LDIGRAPH_VERTEX_MAX)
+	    {
+	      worker->dist[w] = d + 1;
+	      worker->queue[tail++] = w;
+	    }
+	}
+    }
+
+  // leave the arrays ready for the next search
+  for (size_t i = 0; i < tail; i++)
+    {
+      worker->dist[worker->queue[i]] = LDIGRAPH_VERTEX_MAX;
+    }
+  for (size_t i = 0; i < root_label->size; i++)
+    {
+      worker->hub_dist[root_label->entries[i].vertex] = LDIGRAPH_VERTEX_MAX;
+    }
+
+  return ok;
+}
+
+
+bool ldigraph_label_list_add(ldigraph_label_list *list, size_t vertex, size_t dist)
+{
+  if (list->size == list->cap)
+    {
+      size_t cap = list->cap > 0 ? list->cap * 2 : LDIGRAPH_LABEL_INITIAL_CAPACITY;
+      ldigraph_label *bigger = realloc(list->entries, sizeof(ldigraph_label) * cap);
+      if (bigger == NULL)
+	{
+	  return false;
+	}
+      list->entries = bigger;
+      list->cap = cap;
+    }
+
+  list->entries[list->size].vertex = vertex;
+  list->entries[list->size].dist = dist;
+  list->size++;
+  return true;
+}
+
+
+int ldigraph_labels_distance(const ldigraph *g, size_t from, size_t to)
+{
+  // both labels are sorted by the rank of the hub
+  const ldigraph_label *out = g->labels[LDIGRAPH_LABEL_OUT] + g->label_offset[LDIGRAPH_LABEL_OUT][from];
+  const ldigraph_label *out_end = g->labels[LDIGRAPH_LABEL_OUT] + g->label_offset[LDIGRAPH_LABEL_OUT][from + 1];
+  const ldigraph_label *in = g->labels[LDIGRAPH_LABEL_IN] + g->label_offset[LDIGRAPH_LABEL_IN][to];
+  const ldigraph_label *in_end = g->labels[LDIGRAPH_LABEL_IN] + g->label_offset[LDIGRAPH_LABEL_IN][to + 1];
+  size_t best = SIZE_MAX;
+  while (out < out_end && in < in_end)
+    {
+      if (out->vertex < in->vertex)
+	{
+	  out++;
+	}
+      else if (out->vertex > in->vertex)
+	{
+	  in++;
+	}
+      else
+	{
+	  if ((size_t)out->dist + in->dist < best)
+	    {
+	      best = (size_t)out->dist + in->dist;
+	    }
+	  out++;
+	  in++;
+	}
+    }
+
+  return best == SIZE_MAX ? -1 : (int)best;
+}
+
+
+size_t ldigraph_label_count(const ldigraph *g)
+{
+  if (g == NULL || g->labels[LDIGRAPH_LABEL_OUT] == NULL)
+    {
+      return 0;
+    }
+
+  return g->label_offset[LDIGRAPH_LABEL_OUT][g->n] + g->label_offset[LDIGRAPH_LABEL_IN][g->n];
+}
+
+
+bool ldigraph_save_labels(const ldigraph *g, const char *filename)
+{
+  if (g == NULL || filename == NULL || g->labels[LDIGRAPH_LABEL_OUT] == NULL)
+    {
+      return false;
+    }
+
+  FILE *out = fopen(filename, "wb");
+  if (out == NULL)
+    {
+      return false;
+    }
+
+  ldigraph_labels_header header;
+  ldigraph_labels_header_init(g, &header);
+  bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+  for (int kind = 0; ok && kind < 2; kind++)
+    {
+      ok = (fwrite(g->label_offset[kind], sizeof(size_t), g->n + 1, out) == g->n + 1
+	    && fwrite(g->labels[kind], sizeof(ldigraph_label), header.count[kind], out) == header.count[kind]);
+    }
+
+  // a partial file must not be mistaken for a good one later
+  ok = fclose(out) == 0 && ok;
+  if (!ok)
+    {
+      remove(filename);
+    }
+  return ok;
+}
+
+
+bool ldigraph_load_labels(ldigraph *g, const char *filename)
+{
+  if (g == NULL || filename == NULL || !ldigraph_freeze(g))
+    {
+      return false;
+    }
+
+  FILE *in = fopen(filename, "rb");
+  if (in == NULL)
+    {
+      return false;
+    }
+
+  // the labels only fit the graph they were built for
+  ldigraph_labels_header expected;
+  ldigraph_labels_header header;
+  ldigraph_labels_header_init(g, &expected);
+  bool ok = (fread(&header, sizeof(header), 1, in) == 1
+	     && memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0
+	     && header.version == expected.version && header.vertex_size == expected.vertex_size
+	     && header.offset_size == expected.offset_size && header.n == expected.n
+	     && header.m == expected.m && header.fingerprint == expected.fingerprint);
+
+  size_t *label_offset[2] = {NULL, NULL};
+  ldigraph_label *labels[2] = {NULL, NULL};
+  for (int kind = 0; ok && kind < 2; kind++)
+    {
+      label_offset[kind] = malloc(sizeof(size_t) * (g->n + 1));
+      labels[kind] = malloc(sizeof(ldigraph_label) * (header.count[kind] > 0 ? header.count[kind] : 1));
+      ok = (label_offset[kind] != NULL && labels[kind] != NULL
+	    && fread(label_offset[kind], sizeof(size_t), g->n + 1, in) == g->n + 1
+	    && fread(labels[kind], sizeof(ldigraph_label), header.count[kind], in) == header.count[kind]
+	    && label_offset[kind][0] == 0 && label_offset[kind][g->n] == header.count[kind]);
+
+      // check that queries will stay in bounds and find hubs in order
+      for (size_t v = 0; ok && v < g->n; v++)
+	{
+	  ok = label_offset[kind][v] <= label_offset[kind][v + 1];
+	  for (size_t i = label_offset[kind][v]; ok && i < label_offset[kind][v + 1]; i++)
+	    {
+	      ok = labels[kind][i].vertex < g->n && (i == label_offset[kind][v] || labels[kind][i - 1].vertex < labels[kind][i].vertex);
+	    }
+	}
+    }
+  fclose(in);
+
+  if (ok)
+    {
+      ldigraph_labels_clear(g);
+      for (int kind = 0; kind < 2; kind++)
+	{
+	  g->label_offset[kind] = label_offset[kind];
+	  g->labels[kind] = labels[kind];
+	}
+    }
+  else
+    {
+      for (int kind = 0; kind < 2; kind++)
+	{
+	  free(label_offset[kind]);
+	  free(labels[kind]);
+	}
+    }
+  return ok;
+}
+
+
+void ldigraph_labels_header_init(const ldigraph *g, ldigraph_labels_header *header)
+{
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, LDIGRAPH_LABELS_MAGIC, sizeof(header->magic));
+  header->version = LDIGRAPH_LABELS_VERSION;
+  header->vertex_size = sizeof(ldigraph_vertex);
+  header->offset_size = sizeof(size_t);
+  header->n = g->n;
+  header->m = g->m;
+
+  // FNV-1a over the out-degrees and targets, a word at a time
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t v = 0; v < g->n; v++)
+    {
+      hash = (hash ^ ldigraph_out_degree(g, v)) * 1099511628211ULL;
+    }
+  for (size_t v = 0; v < g->n; v++)
+    {
+      ldigraph_cursor edges;
+      size_t count = ldigraph_out_edges(g, v, &edges);
+      for (size_t i = 0; i < count; i++)
+	{
+	  hash = (hash ^ ldigraph_cursor_next(&edges)) * 1099511628211ULL;
+	}
+    }
+  header->fingerprint = hash;
+
+  if (g->labels[LDIGRAPH_LABEL_OUT] != NULL)
+    {
+      header->count[LDIGRAPH_LABEL_OUT] = g->label_offset[LDIGRAPH_LABEL_OUT][g->n];
+      header->count[LDIGRAPH_LABEL_IN] = g->label_offset[LDIGRAPH_LABEL_IN][g->n];
+    }
+}
+
+
+void ldigraph_labels_clear(ldigraph *g)
+{
+  for (int kind = 0; kind < 2; kind++)
+    {
+      free(g->label_offset[kind]);
+      free(g->labels[kind]);
+      g->label_offset[kind] = NULL;
+      g->labels[kind] = NULL;
+    }
+}
+
+
+bool ldigraph_build_landmarks(ldigraph *g, size_t count)
+{
+  if (g == NULL || count == 0 || !ldigraph_build_in_edges(g))
+    {
+      return false;
+    }
+
+  if (count > g->n)
+    {
+      count = g->n;
+    }
+  
+  ldigraph_vertex *dist = malloc(sizeof(ldigraph_vertex) * 2 * count * g->n);
+  ldigraph_vertex *nearest = malloc(sizeof(ldigraph_vertex) * g->n);
+  ldigraph_vertex *queue = malloc(sizeof(ldigraph_vertex) * g->n);
+  if (dist == NULL || nearest == NULL || queue == NULL)
+    {
+      free(dist);
+      free(nearest);
+      free(queue);
+      return false;
+    }
+
+  // the first landmark is the vertex farthest from vertex 0, and each
+  // one after that is the vertex farthest from the landmarks so far,
+  // where vertices no landmark reaches are farthest of all
+  ldigraph_landmark_bfs(g, 0, true, nearest, 1, queue);
+  for (size_t i = 0; i < count; i++)
+    {
+      size_t farthest = 0;
+      for (size_t v = 1; v < g->n; v++)
+	{
+	  if (nearest[v] > nearest[farthest])
+	    {
+	      farthest = v;
+	    }
+	}
+      if (i == 0)
+	{
+	  for (size_t v = 0; v < g->n; v++)
+	    {
+	      nearest[v] = LDIGRAPH_VERTEX_MAX;
+	    }
+	}
+
+      // distances from the landmark, then distances to it
+      ldigraph_landmark_bfs(g, farthest, true, dist + i, 2 * count, queue);
+      ldigraph_landmark_bfs(g, farthest, false, dist + count + i, 2 * count, queue);
+      for (size_t v = 0; v < g->n; v++)
+	{
+	  if (dist[v * 2 * count + i] < nearest[v])
+	    {
+	      nearest[v] = dist[v * 2 * count + i];
+	    }
+	}
+    }
+  free(nearest);
+  free(queue);
+
+  free(g->landmark_dist);
+  g->landmark_dist = dist;
+  g->landmarks = count;
+  return true;
+}
+
+
+void ldigraph_landmark_bfs(const ldigraph *g, size_t from, bool forward, ldigraph_vertex *dist, size_t stride, ldigraph_vertex *queue)
+{
+  for (size_t v = 0; v < g->n; v++)
+    {
+      dist[v * stride] = LDIGRAPH_VERTEX_MAX;
+    }
+
+  dist[from * stride] = 0;
+  queue[0] = from;
+  size_t head = 0;
+  size_t tail = 1;
+  while (head < tail)
+    {
+      size_t v = queue[head++];
+      ldigraph_cursor edges;
+      size_t count = forward ? ldigraph_out_edges(g, v, &edges) : ldigraph_in_edges(g, v, &edges);
+      for (size_t i = 0; i < count; i++)
+	{
+	  size_t w = ldigraph_cursor_next(&edges);
+	  if (dist[w * stride] == LDIGRAPH_VERTEX_MAX)
+	    {
+	      dist[w * stride] = dist[v * stride] + 1;
+	      queue[tail++] = w;
+	    }
+	}
+    }
+}
+
+
+size_t ldigraph_landmark_bound(const ldigraph *g, size_t v, const ldigraph_vertex *target)
+{
+  size_t k = g->landmarks;
+  const ldigraph_vertex *source = g->landmark_dist + v * 2 * k;
+  size_t bound = 0;
+  for (size_t i = 0; i < k; i++)
+    {
+      // d(L, to) <= d(L, v) + d(v, to)
+      if (target[i] != LDIGRAPH_VERTEX_MAX)
+	{
+	  if (source[i] != LDIGRAPH_VERTEX_MAX && target[i] > source[i] && target[i] - source[i] > bound)
+	    {
+	      bound = target[i] - source[i];
+	    }
+	}
+      else if (source[i] != LDIGRAPH_VERTEX_MAX)
+	{
+	  // the landmark reaches v but not to
+	  return LDIGRAPH_VERTEX_MAX;
+	}
+
+      // d(v, L) <= d(v, to) + d(to, L)
+      if (source[k + i] != LDIGRAPH_VERTEX_MAX)
+	{
+	  if (target[k + i] != LDIGRAPH_VERTEX_MAX && source[k + i] > target[k + i] && source[k + i] - target[k + i] > bound)
+	    {
+	      bound = source[k + i] - target[k + i];
+	    }
+	}
+      else if (target[k + i] != LDIGRAPH_VERTEX_MAX)
+	{
+	  // to reaches the landmark but v does not
+	  return LDIGRAPH_VERTEX_MAX;
+	}
+    }
+
+  return bound;
+}
+
+
+int ldigraph_alt_search(const ldigraph *g, ldigraph_search *s, size_t from, size_t to)
+{
+  ldigraph_search_init(s, g);
+
+  const ldigraph_vertex *target = g->landmark_dist + to * 2 * g->landmarks;
+  size_t bound = ldigraph_landmark_bound(g, from, target);
+  size_t size = 0;
+  ldigraph_search_reach(s, from, 0, LDIGRAPH_VERTEX_MAX);
+  if (bound == LDIGRAPH_VERTEX_MAX || !ldigraph_heap_push(s, &size, from, bound))
+    {
+      return -1;
+    }
+
+  while (size > 0)
+    {
+      // a vertex may be in the heap more than once; the first time it
+      // comes out its distance is final, since the bounds are consistent
+      size_t curr = ldigraph_heap_pop(s, &size);
+      if (ldigraph_search_color(s, curr) == LDIGRAPH_DONE)
+	{
+	  continue;
+	}
+      else if (curr == to)
+	{
+	  return ldigraph_search_dist(s, to);
+	}
+      s->color[curr] = LDIGRAPH_DONE;
+
+      ldigraph_cursor edges;
+      size_t count = ldigraph_out_edges(g, curr, &edges);
+      s->vertices_scanned++;
+      s->edges_scanned += count;
+      int dist = s->dist[curr] + 1;
+      for (size_t i = 0; i < count; i++)
+	{
+	  size_t next = ldigraph_cursor_next(&edges);
+	  int color = ldigraph_search_color(s, next);
+	  if (color == LDIGRAPH_UNSEEN || (color == LDIGRAPH_PROCESSING && dist < s->dist[next]))
+	    {
+	      bound = ldigraph_landmark_bound(g, next, target);
+	      ldigraph_search_reach(s, next, dist, curr);
+	      if (bound == LDIGRAPH_VERTEX_MAX)
+		{
+		  // there is no path to the end through next
+		  s->color[next] = LDIGRAPH_DONE;
+		}
+	      else if (!ldigraph_heap_push(s, &size, next, dist + bound))
+		{
+		  return -1;
+		}
+	    }
+	}
+    }
+
+  return -1;
+}
+
+
+bool ldigraph_heap_push(ldigraph_search *s, size_t *size, size_t v, size_t key)
+{
+  if (!ldigraph_search_reserve_stack(s, *size + 1))
+    {
+      return false;
+    }
+
+  // sift up
+  size_t i = (*size)++;
+  while (i > 0 && ldigraph_heap_before(s, v, key, &s->stack[(i - 1) / 2]))
+    {
+      s->stack[i] = s->stack[(i - 1) / 2];
+      i = (i - 1) / 2;
+    }
+  s->stack[i].vertex = v;
+  s->stack[i].next = key;
+  return true;
+}
+
+
+size_t ldigraph_heap_pop(ldigraph_search *s, size_t *size)
+{
+  size_t top = s->stack[0].vertex;
+  ldigraph_dfs_frame last = s->stack[--*size];
+
+  // sift the last entry down from the root
+  size_t i = 0;
+  while (2 * i + 1 < *size)
+    {
+      size_t child = 2 * i + 1;
+      if (child + 1 < *size
+	  && ldigraph_heap_before(s, s->stack[child + 1].vertex, s->stack[child + 1].next, &s->stack[child]))
+	{
+	  child++;
+	}
+      if (!ldigraph_heap_before(s, s->stack[child].vertex, s->stack[child].next, &last))
+	{
+	  break;
+	}
+      s->stack[i] = s->stack[child];
+      i = child;
+    }
+  s->stack[i] = last;
+  
+  return top;
+}
+
+
+bool ldigraph_heap_before(const ldigraph_search *s, size_t v, size_t key, const ldigraph_dfs_frame *entry)
+{
+  // among equal estimates, the vertex farthest from the start is
+  // likely closest to the end
+  return key < entry->next || (key == entry->next && s->dist[v] > s->dist[entry->vertex]);
+}
+
+
+bool ldigraph_topological_order(ldigraph *g)
+{
+  if (g->order_state != LDIGRAPH_ORDER_UNKNOWN)
+    {
+      return true;
+    }
+
+  // Kahn's algorithm: repeatedly remove vertices with no remaining in-edges,
+  // using order as the queue of removed vertices
+  ldigraph_vertex *order = malloc(sizeof(ldigraph_vertex) * (g->n > 0 ? g->n : 1));
+  ldigraph_vertex *in_degree = calloc(g->n > 0 ? g->n : 1, sizeof(ldigraph_vertex));
+  if (order == NULL || in_degree == NULL)
+    {
+      free(order);
+      free(in_degree);
+      return false;
+    }
+
+  for (size_t v = 0; v < g->n; v++)
+    {
+      ldigraph_cursor edges;
+      size_t count = ldigraph_out_edges(g, v, &edges);
+      for (size_t i = 0; i < count; i++)
+	{
+	  in_degree[ldigraph_cursor_next(&edges)]++;
+	}
+    }
+
+  size_t tail = 0;
+  for (size_t v = 0; v < g->n; v++)
+    {
+      if (in_degree[v] == 0)
+	{
+	  order[tail++] = v;
+	}
+    }
+  
+  for (size_t head = 0; head < tail; head++)
+    {
+      ldigraph_cursor edges;
+      size_t count = ldigraph_out_edges(g, order[head], &edges);
+      for (size_t i = 0; i < count; i++)
+	{
+	  size_t next = ldigraph_cursor_next(&edges);
+	  if (--in_degree[next] == 0)
+	    {
+	      order[tail++] = next;
+	    }
+	}
+    }
+
+  if (tail < g->n)
+    {
+      // the vertices never removed are on or after a cycle
+      free(order);
+      free(in_degree);
+      g->order_state = LDIGRAPH_ORDER_CYCLIC;
+      return true;
+    }
+
+  // the in-degrees are all zero now, so reuse the array for positions
+  for (size_t i = 0; i < g->n; i++)
+    {
+      in_degree[order[i]] = i;
+    }
+  
+  g->order = order;
+  g->position = in_degree;
+  g->order_state = LDIGRAPH_ORDER_ACYCLIC;
+  return true;
+}
+
+
+int ldigraph_longest_path_dag(const ldigraph *g, ldigraph_search *s, size_t from, size_t to)
+{
+  ldigraph_search_init(s, g);
+
+  // a path can only use vertices between its ends in topological order
+  size_t first = g->position[from];
+  size_t last = g->position[to];
+  if (first > last)
+    {
+      return -1;
+    }
+  
+  ldigraph_search_reach(s, from, 0, LDIGRAPH_VERTEX_MAX);
+  for (size_t i = first; i < last; i++)
+    {
+      // vertices not reached from from are not stamped
+      size_t curr = g->order[i];
+      if (ldigraph_search_color(s, curr) == LDIGRAPH_UNSEEN)
+	{
+	  continue;
+	}
+
+      // every path to curr has been seen, so its length is final
+      ldigraph_cursor edges;
+      size_t count = ldigraph_out_edges(g, curr, &edges);
+      s->vertices_scanned++;
+      s->edges_scanned += count;
+      for (size_t j = 0; j < count; j++)
+	{
+	  size_t next = ldigraph_cursor_next(&edges);
+	  if (g->position[next] <= last
+	      && (ldigraph_search_color(s, next) == LDIGRAPH_UNSEEN || s->dist[next] < s->dist[curr] + 1))
+	    {
+	      ldigraph_search_reach(s, next, s->dist[curr] + 1, curr);
+	    }
+	}
+      s->color[curr] = LDIGRAPH_DONE;
+    }
+
+  return ldigraph_search_dist(s, to);
+}
+
+
+int ldigraph_longest_path_reached(const ldigraph *g, ldigraph_search *s, size_t to, bool *acyclic)
+{
+  // number the vertices in reverse finishing order, in pred since the
+  // DFS tree is not needed; every vertex reached has a path from from,
+  // so each gets its final length before its turn comes
+  size_t count = s->finished;
+  for (size_t i = 0; i < count; i++)
+    {
+      size_t v = s->queue[count - 1 - i];
+      s->pred[v] = i;
+      s->dist[v] = 0;
+    }
+
+  *acyclic = true;
+  for (size_t i = 0; i < count && *acyclic; i++)
+    {
+      size_t curr = s->queue[count - 1 - i];
+      ldigraph_cursor edges;
+      size_t degree = ldigraph_out_edges(g, curr, &edges);
+      s->vertices_scanned++;
+      s->edges_scanned += degree;
+      for (size_t j = 0; j < degree && *acyclic; j++)
+	{
+	  // an edge to a vertex numbered no later closes a cycle
+	  size_t next = ldigraph_cursor_next(&edges);
+	  *acyclic = s->pred[next] > i;
+	  if (s->dist[next] < s->dist[curr] + 1)
+	    {
+	      s->dist[next] = s->dist[curr] + 1;
+	    }
+	}
+    }
+
+  return *acyclic ? s->dist[to] : -1;
+}
+
+
+bool ldigraph_components_build(ldigraph *g)
+{
+  if (g->component != NULL)
+    {
+      return true;
+    }
+
+  size_t n = g->n > 0 ? g->n : 1;
+  ldigraph_vertex *index = malloc(sizeof(ldigraph_vertex) * n);
+  ldigraph_vertex *low = malloc(sizeof(ldigraph_vertex) * n);
+  ldigraph_vertex *pending = malloc(sizeof(ldigraph_vertex) * n);
+  ldigraph_vertex *component = malloc(sizeof(ldigraph_vertex) * n);
+  ldigraph_vertex *local = malloc(sizeof(ldigraph_vertex) * n);
+  ldigraph_vertex *members = malloc(sizeof(ldigraph_vertex) * n);
+  ldigraph_dfs_frame *stack = malloc(sizeof(ldigraph_dfs_frame) * n);
+  size_t *offset = NULL;
+  if (index == NULL || low == NULL || pending == NULL || component == NULL || local == NULL
+      || members == NULL || stack == NULL)
+    {
+      free(index);
+      free(low);
+      free(pending);
+      free(component);
+      free(local);
+      free(members);
+      free(stack);
+      return false;
+    }
+
+  // Tarjan's algorithm with the DFS path kept in frames; a vertex is
+  // waiting on the pending stack if it has an index but no component
+  for (size_t v = 0; v < g->n; v++)
+    {
+      index[v] = LDIGRAPH_VERTEX_MAX;
+      component[v] = LDIGRAPH_VERTEX_MAX;
+    }
+  size_t count = 0;
+  size_t visited = 0;
+  size_t pending_size = 0;
+  for (size_t root = 0; root < g->n; root++)
+    {
+      if (index[root] != LDIGRAPH_VERTEX_MAX)
+	{
+	  continue;
+	}
+
+      index[root] = low[root] = visited++;
+      pending[pending_size++] = root;
+      stack[0].vertex = root;
+      stack[0].next = 0;
+      ldigraph_out_edges(g, root, &stack[0].edges);
+      size_t depth = 1;
+      while (depth > 0)
+	{
+	  ldigraph_dfs_frame *top = &stack[depth - 1];
+	  size_t curr = top->vertex;
+	  if (top->next < ldigraph_out_degree(g, curr))
+	    {
+	      size_t to = ldigraph_cursor_next(&top->edges);
+	      top->next++;
+	      if (index[to] == LDIGRAPH_VERTEX_MAX)
+		{
+		  index[to] = low[to] = visited++;
+		  pending[pending_size++] = to;
+		  stack[depth].vertex = to;
+		  stack[depth].next = 0;
+		  ldigraph_out_edges(g, to, &stack[depth].edges);
+		  depth++;
+		}
+	      else if (component[to] == LDIGRAPH_VERTEX_MAX && index[to] < low[curr])
+		{
+		  low[curr] = index[to];
+		}
+	    }
+	  else
+	    {
+	      if (low[curr] == index[curr])
+		{
+		  // curr is the first vertex found in its component
+		  size_t v;
+		  do
+		    {
+		      v = pending[--pending_size];
+		      component[v] = count;
+		    }
+		  while (v != curr);
+		  count++;
+		}
+
+	      depth--;
+	      if (depth > 0 && low[curr] < low[stack[depth - 1].vertex])
+		{
+		  low[stack[depth - 1].vertex] = low[curr];
+		}
+	    }
+	}
+    }
+  free(index);
+  free(low);
+  free(pending);
+  free(stack);
+
+  // components are finished sinks first, so number them the other way
+  // around to put them in topological order, then group their members
+  offset = calloc(count + 1, sizeof(size_t));
+  if (offset == NULL)
+    {
+      free(component);
+      free(local);
+      free(members);
+      return false;
+    }
+  for (size_t v = 0; v < g->n; v++)
+    {
+      component[v] = count - 1 - component[v];
+      offset[component[v] + 1]++;
+    }
+  for (size_t c = 0; c < count; c++)
+    {
+      offset[c + 1] += offset[c];
+    }
+  for (size_t v = 0; v < g->n; v++)
+    {
+      size_t c = component[v];
+      local[v] = offset[c];
+      members[offset[c]++] = v;
+    }
+  for (size_t c = count; c > 0; c--)
+    {
+      offset[c] = offset[c - 1];
+    }
+  offset[0] = 0;
+  for (size_t v = 0; v < g->n; v++)
+    {
+      local[v] -= offset[component[v]];
+    }
+  
+  g->component = component;
+  g->local = local;
+  g->components = count;
+  g->component_offset = offset;
+  g->members = members;
+  return true;
+}
+
+
+int ldigraph_longest_path_components(const ldigraph *g, ldigraph_search *s, size_t from, size_t to)
+{
+  // a path goes through components in topological order, so only the
+  // ones numbered between those of from and to can be on it
+  size_t first = g->component[from];
+  size_t last = g->component[to];
+  if (first > last)
+    {
+      return -1;
+    }
+  
+  // the longest path found so far to each vertex in that range arriving
+  // from another component (or starting there), and to each vertex
+  // leaving its component, both indexed from the first member of first
+  size_t base = g->component_offset[first];
+  size_t span = g->component_offset[last + 1] - base;
+  int *best_in = malloc(sizeof(int) * span);
+  int *best_out = malloc(sizeof(int) * span);
+  size_t largest = 1;
+  for (size_t c = first; c <= last; c++)
+    {
+      size_t k = g->component_offset[c + 1] - g->component_offset[c];
+      if (k <= LDIGRAPH_SUBSET_DP_LIMIT && k > largest)
+	{
+	  largest = k;
+	}
+    }
+  uint32_t *dp = malloc(sizeof(uint32_t) * ((size_t)1 << largest));
+  uint32_t *adjacent = malloc(sizeof(uint32_t) * largest);
+  int *inner = malloc(sizeof(int) * largest);
+  ldigraph_path_search *ps = NULL;
+  uint64_t *allowed = NULL;
+  
+  bool ok = best_in != NULL && best_out != NULL && dp != NULL && adjacent != NULL && inner != NULL;
+  for (size_t i = 0; ok && i < span; i++)
+    {
+      best_in[i] = -1;
+      best_out[i] = -1;
+    }
+  if (ok)
+    {
+      best_in[g->component_offset[first] + g->local[from] - base] = 0;
+    }
+
+  for (size_t c = first; ok && c <= last; c++)
+    {
+      size_t start = g->component_offset[c];
+      size_t k = g->component_offset[c + 1] - start;
+      const ldigraph_vertex *members = g->members + start;
+      int *in = best_in + (start - base);
+      int *out = best_out + (start - base);
+
+      bool entered = false;
+      for (size_t i = 0; i < k; i++)
+	{
+	  entered = entered || in[i] >= 0;
+	}
+      if (!entered)
+	{
+	  continue;
+	}
+      
+      if (k == 1)
+	{
+	  out[0] = in[0];
+	}
+      else if (k <= LDIGRAPH_SUBSET_DP_LIMIT)
+	{
+	  // longest paths within the component from each entry vertex
+	  for (size_t i = 0; i < k; i++)
+	    {
+	      ldigraph_cursor edges;
+	      size_t count = ldigraph_out_edges(g, members[i], &edges);
+	      s->vertices_scanned++;
+	      s->edges_scanned += count;
+	      adjacent[i] = 0;
+	      for (size_t j = 0; j < count; j++)
+		{
+		  size_t next = ldigraph_cursor_next(&edges);
+		  if (g->component[next] == c)
+		    {
+		      adjacent[i] |= (uint32_t)1 << g->local[next];
+		    }
+		}
+	    }
+	  
+	  uint32_t waiting = 0;
+	  for (size_t i = 0; i < k; i++)
+	    {
+	      if (in[i] >= 0)
+		{
+		  waiting |= (uint32_t)1 << i;
+		}
+	    }
+	  while (waiting != 0)
+	    {
+	      // entry vertices reached by equally long paths share a table
+	      int length = in[__builtin_ctz(waiting)];
+	      uint32_t entries = 0;
+	      for (size_t i = 0; i < k; i++)
+		{
+		  if (in[i] == length)
+		    {
+		      entries |= (uint32_t)1 << i;
+		    }
+		}
+	      waiting &= ~entries;
+	      
+	      ldigraph_subset_dp(k, adjacent, entries, dp, inner);
+	      for (size_t j = 0; j < k; j++)
+		{
+		  if (inner[j] >= 0 && length + inner[j] > out[j])
+		    {
+		      out[j] = length + inner[j];
+		    }
+		}
+	    }
+	}
+      else
+	{
+	  // too big for the table: search between each entry vertex and
+	  // each vertex that can leave the component or ends the path
+	  if (ps == NULL)
+	    {
+	      ps = ldigraph_path_search_create(g, NULL);
+	      allowed = calloc((g->n + 63) / 64, sizeof(uint64_t));
+	      ok = ps != NULL && allowed != NULL;
+	    }
+	  for (size_t i = 0; ok && i < k; i++)
+	    {
+	      allowed[members[i] / 64] |= (uint64_t)1 << (members[i] % 64);
+	    }
+	  
+	  for (size_t j = 0; ok && j < k; j++)
+	    {
+	      bool leaves = members[j] == to;
+	      ldigraph_cursor edges;
+	      size_t count = ldigraph_out_edges(g, members[j], &edges);
+	      for (size_t e = 0; !leaves && e < count; e++)
+		{
+		  size_t d = g->component[ldigraph_cursor_next(&edges)];
+		  leaves = d > c && d <= last;
+		}
+	      
+	      for (size_t i = 0; ok && leaves && i < k; i++)
+		{
+		  if (in[i] >= 0)
+		    {
+		      int length = ldigraph_path_search_run(ps, members[i], members[j], allowed);
+		      if (length >= 0 && in[i] + length > out[j])
+			{
+			  out[j] = in[i] + length;
+			}
+		    }
+		}
+	    }
+	  
+	  for (size_t i = 0; ok && i < k; i++)
+	    {
+	      allowed[members[i] / 64] &= ~((uint64_t)1 << (members[i] % 64));
+	    }
+	}
+
+      // follow the edges out of the component
+      for (size_t i = 0; i < k && c < last; i++)
+	{
+	  if (out[i] >= 0)
+	    {
+	      ldigraph_cursor edges;
+	      size_t count = ldigraph_out_edges(g, members[i], &edges);
+	      for (size_t e = 0; e < count; e++)
+		{
+		  size_t next = ldigraph_cursor_next(&edges);
+		  size_t d = g->component[next];
+		  if (d > c && d <= last)
+		    {
+		      int *arrive = &best_in[g->component_offset[d] + g->local[next] - base];
+		      if (out[i] + 1 > *arrive)
+			{
+			  *arrive = out[i] + 1;
+			}
+		    }
+		}
+	    }
+	}
+    }
+
+  int longest = ok ? best_out[g->component_offset[last] + g->local[to] - base] : -1;
+  if (ps != NULL)
+    {
+      s->vertices_scanned += ps->vertices_scanned;
+      s->edges_scanned += ps->edges_scanned;
+    }
+  ldigraph_path_search_destroy(ps);
+  free(allowed);
+  free(best_in);
+  free(best_out);
+  free(dp);
+  free(adjacent);
+  free(inner);
+  
+  return longest;
+}
+
+
+void ldigraph_subset_dp(size_t k, const uint32_t *adjacent, uint32_t entries, uint32_t *dp, int *inner)
+{
+  // dp[mask] is the set of vertices where a path from an entry through
+  // exactly the vertices in mask can end; every path through mask is
+  // built from a smaller mask, so one pass in increasing order does
+  size_t masks = (size_t)1 << k;
+  for (size_t mask = 0; mask < masks; mask++)
+    {
+      dp[mask] = 0;
+    }
+  for (size_t i = 0; i < k; i++)
+    {
+      inner[i] = -1;
+    }
+  
+  for (uint32_t rest = entries; rest != 0; rest &= rest - 1)
+    {
+      dp[rest & -rest] = rest & -rest;
+    }
+  for (size_t mask = entries & -entries; mask < masks; mask++)
+    {
+      uint32_t ends = dp[mask];
+      if (ends == 0)
+	{
+	  continue;
+	}
+
+      int length = __builtin_popcountll(mask) - 1;
+      while (ends != 0)
+	{
+	  int v = __builtin_ctz(ends);
+	  ends &= ends - 1;
+	  if (length > inner[v])
+	    {
+	      inner[v] = length;
+	    }
+	  
+	  uint32_t extend = adjacent[v] & ~(uint32_t)mask;
+	  while (extend != 0)
+	    {
+	      uint32_t bit = extend & -extend;
+	      extend &= extend - 1;
+	      dp[mask | bit] |= bit;
+	    }
+	}
+    }
+}
+
+
+ldigraph_path_search *ldigraph_path_search_create(const ldigraph *g, const ldigraph_path_search *share)
+{
+  ldigraph_path_search *ps = malloc(sizeof(ldigraph_path_search));
+  if (ps == NULL)
+    {
+      return NULL;
+    }
+
+  size_t n = g->n > 0 ? g->n : 1;
+  ps->g = g;
+  ps->words = (n + 63) / 64;
+  ps->can_reach = malloc(sizeof(uint64_t) * ps->words);
+  ps->on_path = malloc(sizeof(uint64_t) * ps->words);
+  ps->stamp = calloc(n, sizeof(uint32_t));
+  ps->epoch = 0;
+  ps->queue = malloc(sizeof(ldigraph_vertex) * n);
+  ps->in_offset = share != NULL ? share->in_offset : g->in_offset;
+  ps->sources = share != NULL ? share->sources : g->sources;
+  ps->own_offset = NULL;
+  ps->own_sources = NULL;
+  ps->stack = NULL;
+  ps->stack_cap = 0;
+  ps->children = NULL;
+  ps->children_cap = 0;
+  ps->vertices_scanned = 0;
+  ps->edges_scanned = 0;
+  ps->budget = SIZE_MAX;
+  ps->deadline = 0;
+  ps->next_clock = 0;
+  ps->stopped = false;
+  ps->random = 0;
+
+  bool ok = ps->can_reach != NULL && ps->on_path != NULL && ps->stamp != NULL && ps->queue != NULL;
+  if (ok && ps->in_offset == NULL && !ldigraph_has_in_edges(g))
+    {
+      // counting sort of the edges by target, as in ldigraph_build_in_edges,
+      // but without freezing the graph
+      size_t m = 0;
+      for (size_t u = 0; u < g->n; u++)
+	{
+	  m += ldigraph_out_degree(g, u);
+	}
+      
+      ps->own_offset = calloc(g->n + 1, sizeof(size_t));
+      ps->own_sources = malloc(sizeof(ldigraph_vertex) * (m > 0 ? m : 1));
+      ok = ps->own_offset != NULL && ps->own_sources != NULL;
+      if (ok)
+	{
+	  for (size_t u = 0; u < g->n; u++)
+	    {
+	      ldigraph_cursor edges;
+	      size_t count = ldigraph_out_edges(g, u, &edges);
+	      for (size_t i = 0; i < count; i++)
+		{
+		  ps->own_offset[ldigraph_cursor_next(&edges)]++;
+		}
+	    }
+
+	  size_t start = 0;
+	  for (size_t v = 0; v < g->n; v++)
+	    {
+	      size_t count = ps->own_offset[v];
+	      ps->own_offset[v] = start;
+	      start += count;
+	    }
+
+	  for (size_t u = 0; u < g->n; u++)
+	    {
+	      ldigraph_cursor edges;
+	      size_t count = ldigraph_out_edges(g, u, &edges);
+	      for (size_t i = 0; i < count; i++)
+		{
+		  ps->own_sources[ps->own_offset[ldigraph_cursor_next(&edges)]++] = u;
+		}
+	    }
+	  
+	  for (size_t v = g->n; v > 0; v--)
+	    {
+	      ps->own_offset[v] = ps->own_offset[v - 1];
+	    }
+	  ps->own_offset[0] = 0;
+	  
+	  ps->in_offset = ps->own_offset;
+	  ps->sources = ps->own_sources;
+	}
+    }
+
+  if (!ok)
+    {
+      ldigraph_path_search_destroy(ps);
+      return NULL;
+    }
+  
+  return ps;
+}
+
+
+int ldigraph_path_search_run(ldigraph_path_search *ps, size_t from, size_t to, const uint64_t *allowed)
+{
+  const ldigraph *g = ps->g;
+  size_t limit;
+  if (from == to)
+    {
+      return 0;
+    }
+  else if (!ldigraph_path_search_prepare(ps, from, to, allowed, &limit))
+    {
+      return -1;
+    }
+
+  atomic_int longest;
+  atomic_init(&longest, -1);
+  if (g->threads > 1 && ldigraph_path_search_parallel(ps, from, to, limit, &longest))
+    {
+      return atomic_load(&longest);
+    }
+
+  // one thread, or not enough memory or threads for more
+  ldigraph_vertex root = from;
+  atomic_store(&longest, -1);
+  if (!ldigraph_path_search_extend(ps, &root, 1, to, limit, &longest, NULL, 0))
+    {
+      return -1;
+    }
+  return atomic_load(&longest);
+}
+
+
+bool ldigraph_path_search_prepare(ldigraph_path_search *ps, size_t from, size_t to, const uint64_t *allowed, size_t *limit)
+{
+  // find the vertices with a path to to by searching its in-edges
+  for (size_t w = 0; w < ps->words; w++)
+    {
+      ps->can_reach[w] = 0;
+      ps->on_path[w] = 0;
+    }
+  ps->can_reach[to / 64] |= (uint64_t)1 << (to % 64);
+  ps->queue[0] = to;
+  size_t tail = 1;
+  for (size_t head = 0; head < tail; head++)
+    {
+      size_t curr = ps->queue[head];
+      ldigraph_cursor edges;
+      size_t count;
+      if (ps->sources != NULL)
+	{
+	  ldigraph_cursor_start(&edges, curr, ps->sources + ps->in_offset[curr], NULL);
+	  count = ps->in_offset[curr + 1] - ps->in_offset[curr];
+	}
+      else
+	{
+	  count = ldigraph_in_edges(ps->g, curr, &edges);
+	}
+      for (size_t i = 0; i < count; i++)
+	{
+	  size_t prev = ldigraph_cursor_next(&edges);
+	  if (!(ps->can_reach[prev / 64] & ((uint64_t)1 << (prev % 64)))
+	      && (allowed == NULL || (allowed[prev / 64] & ((uint64_t)1 << (prev % 64)))))
+	    {
+	      ps->can_reach[prev / 64] |= (uint64_t)1 << (prev % 64);
+	      ps->queue[tail++] = prev;
+	    }
+	}
+      ps->edges_scanned += count;
+    }
+
+  // no path can be longer than the bound at the start
+  return ldigraph_path_search_bound(ps, from, to, limit);
+}
+
+
+bool ldigraph_path_search_extend(ldigraph_path_search *ps, const ldigraph_vertex *prefix, size_t length, size_t to, size_t limit, atomic_int *longest, ldigraph_path_pool *pool, size_t id)
+{
+  const ldigraph *g = ps->g;
+  for (size_t w = 0; w < ps->words; w++)
+    {
+      ps->on_path[w] = 0;
+    }
+  for (size_t i = 0; i + 1 < length; i++)
+    {
+      ps->on_path[prefix[i] / 64] |= (uint64_t)1 << (prefix[i] % 64);
+    }
+
+  // the path has base + depth vertices on it, so the children of the
+  // last one would be reached with base + depth edges
+  size_t base = length - 1;
+  size_t depth = 0;
+  size_t next = prefix[base];
+  size_t children_size = 0;
+  while (true)
+    {
+      int best = atomic_load_explicit(longest, memory_order_relaxed);
+      if (next != LDIGRAPH_VERTEX_MAX)
+	{
+	  // put next on the path and work out which children are worth trying
+	  if (depth == ps->stack_cap)
+	    {
+	      size_t cap = ps->stack_cap > 0 ? ps->stack_cap * 2 : LDIGRAPH_DFS_INITIAL_STACK;
+	      ldigraph_path_frame *bigger = realloc(ps->stack, sizeof(ldigraph_path_frame) * cap);
+	      if (bigger == NULL)
+		{
+		  return false;
+		}
+	      ps->stack = bigger;
+	      ps->stack_cap = cap;
+	    }
+	  if (ps->budget == 0 || ldigraph_path_search_late(ps))
+	    {
+	      // out of budget; the longest path so far is the best we can do
+	      ps->stopped = true;
+	      return true;
+	    }
+	  else if (ps->budget != SIZE_MAX)
+	    {
+	      ps->budget--;
+	    }
+	  ps->on_path[next / 64] |= (uint64_t)1 << (next % 64);
+	  
+	  ldigraph_cursor edges;
+	  size_t count = ldigraph_out_edges(g, next, &edges);
+	  ps->vertices_scanned++;
+	  ps->edges_scanned += count;
+	  size_t first = children_size;
+	  for (size_t i = 0; i < count; i++)
+	    {
+	      // each child may take a bounding search, so a vertex with
+	      // many children may take longer than the whole budget
+	      if (ldigraph_path_search_late(ps))
+		{
+		  ps->stopped = true;
+		  return true;
+		}
+
+	      size_t child = ldigraph_cursor_next(&edges);
+	      size_t bound;
+	      if ((ps->on_path[child / 64] & ((uint64_t)1 << (child % 64)))
+		  || !(ps->can_reach[child / 64] & ((uint64_t)1 << (child % 64))))
+		{
+		  continue;
+		}
+	      else if (child == to)
+		{
+		  // the path can end here but not go on through to
+		  ldigraph_atomic_max(longest, base + depth + 1);
+		  best = atomic_load_explicit(longest, memory_order_relaxed);
+		}
+	      else if (ldigraph_path_search_bound(ps, child, to, &bound)
+		       && (best < 0 || base + depth + 1 + bound > (size_t)best))
+		{
+		  if (children_size == ps->children_cap)
+		    {
+		      size_t cap = ps->children_cap > 0 ? ps->children_cap * 2 : LDIGRAPH_DFS_INITIAL_STACK;
+		      ldigraph_path_child *bigger = realloc(ps->children, sizeof(ldigraph_path_child) * cap);
+		      if (bigger == NULL)
+			{
+			  return false;
+			}
+		      ps->children = bigger;
+		      ps->children_cap = cap;
+		    }
+		  ps->children[children_size].vertex = child;
+		  ps->children[children_size].bound = bound;
+		  children_size++;
+		}
+	    }
+	  if (children_size - first > 1)
+	    {
+	      qsort(ps->children + first, children_size - first, sizeof(ldigraph_path_child), ldigraph_path_child_compare);
+	    }
+	  
+	  ps->stack[depth].vertex = next;
+	  ps->stack[depth].next = first;
+	  ps->stack[depth].end = children_size;
+	  depth++;
+	}
+
+      if (best >= 0 && (size_t)best == limit)
+	{
+	  // nothing can beat a path that meets the bound for the query
+	  return true;
+	}
+      
+      // try the next child of the vertex at the end of the path whose
+      // bound still beats the longest path so far; near the root of the
+      // subtree, hand children to idle workers instead
+      ldigraph_path_frame *top = &ps->stack[depth - 1];
+      next = LDIGRAPH_VERTEX_MAX;
+      while (next == LDIGRAPH_VERTEX_MAX && top->next < top->end)
+	{
+	  ldigraph_path_child *child = &ps->children[top->next++];
+	  if (best < 0 || base + depth + child->bound > (size_t)best)
+	    {
+	      next = child->vertex;
+	      if (pool != NULL && depth <= LDIGRAPH_PATH_SPLIT_DEPTH && top->next < top->end
+		  && atomic_load_explicit(&pool->idle, memory_order_relaxed) > 0
+		  && ldigraph_path_pool_split(pool, id, prefix, base, ps->stack, depth, next))
+		{
+		  next = LDIGRAPH_VERTEX_MAX;
+		}
+	    }
+	}
+
+      if (next == LDIGRAPH_VERTEX_MAX)
+	{
+	  // back up past the vertex at the end of the path; its children
+	  // were added right after its parent's
+	  size_t curr = top->vertex;
+	  ps->on_path[curr / 64] &= ~((uint64_t)1 << (curr % 64));
+	  depth--;
+	  if (depth == 0)
+	    {
+	      return true;
+	    }
+	  children_size = ps->stack[depth - 1].end;
+	}
+    }
+}
+
+
+bool ldigraph_path_search_dive(ldigraph_path_search *ps, size_t from, size_t to, int *length)
+{
+  const ldigraph *g = ps->g;
+  for (size_t w = 0; w < ps->words; w++)
+    {
+      ps->on_path[w] = 0;
+    }
+
+  // on_path marks every vertex the dive has entered, so none is entered
+  // twice; the path is the stack, with depth vertices and edges to to
+  *length = -1;
+  size_t depth = 0;
+  size_t next = from;
+  size_t children_size = 0;
+  while (true)
+    {
+      if (next != LDIGRAPH_VERTEX_MAX)
+	{
+	  if (depth == ps->stack_cap)
+	    {
+	      size_t cap = ps->stack_cap > 0 ? ps->stack_cap * 2 : LDIGRAPH_DFS_INITIAL_STACK;
+	      ldigraph_path_frame *bigger = realloc(ps->stack, sizeof(ldigraph_path_frame) * cap);
+	      if (bigger == NULL)
+		{
+		  return false;
+		}
+	      ps->stack = bigger;
+	      ps->stack_cap = cap;
+	    }
+	  if (ps->budget == 0 || ldigraph_path_search_late(ps))
+	    {
+	      ps->stopped = true;
+	      return true;
+	    }
+	  else if (ps->budget != SIZE_MAX)
+	    {
+	      ps->budget--;
+	    }
+	  ps->on_path[next / 64] |= (uint64_t)1 << (next % 64);
+
+	  ldigraph_cursor edges;
+	  size_t count = ldigraph_out_edges(g, next, &edges);
+	  ps->vertices_scanned++;
+	  ps->edges_scanned += count;
+	  size_t first = children_size;
+	  for (size_t i = 0; i < count; i++)
+	    {
+	      size_t child = ldigraph_cursor_next(&edges);
+	      if (child == to || (ps->on_path[child / 64] & ((uint64_t)1 << (child % 64)))
+		  || !(ps->can_reach[child / 64] & ((uint64_t)1 << (child % 64))))
+		{
+		  continue;
+		}
+	      if (children_size == ps->children_cap)
+		{
+		  size_t cap = ps->children_cap > 0 ? ps->children_cap * 2 : LDIGRAPH_DFS_INITIAL_STACK;
+		  ldigraph_path_child *bigger = realloc(ps->children, sizeof(ldigraph_path_child) * cap);
+		  if (bigger == NULL)
+		    {
+		      return false;
+		    }
+		  ps->children = bigger;
+		  ps->children_cap = cap;
+		}
+	      ps->children[children_size].vertex = child;
+	      ps->children[children_size].bound = ldigraph_out_degree(g, child);
+	      children_size++;
+	    }
+	  if (ps->random != 0)
+	    {
+	      // shuffle with xorshift so that restarts try different paths
+	      for (size_t i = children_size; i > first + 1; i--)
+		{
+		  ps->random ^= ps->random << 13;
+		  ps->random ^= ps->random >> 7;
+		  ps->random ^= ps->random << 17;
+		  size_t j = first + ps->random % (i - first);
+		  ldigraph_path_child swap = ps->children[i - 1];
+		  ps->children[i - 1] = ps->children[j];
+		  ps->children[j] = swap;
+		}
+	    }
+	  else if (children_size - first > 1)
+	    {
+	      qsort(ps->children + first, children_size - first, sizeof(ldigraph_path_child), ldigraph_path_child_compare);
+	    }
+
+	  ps->stack[depth].vertex = next;
+	  ps->stack[depth].next = first;
+	  ps->stack[depth].end = children_size;
+	  depth++;
+	}
+
+      // go on to the next child not entered since the list was made
+      ldigraph_path_frame *top = &ps->stack[depth - 1];
+      next = LDIGRAPH_VERTEX_MAX;
+      while (next == LDIGRAPH_VERTEX_MAX && top->next < top->end)
+	{
+	  size_t child = ps->children[top->next++].vertex;
+	  if (!(ps->on_path[child / 64] & ((uint64_t)1 << (child % 64))))
+	    {
+	      next = child;
+	    }
+	}
+
+      if (next == LDIGRAPH_VERTEX_MAX)
+	{
+	  // every other way on has been tried, so end the path at to if
+	  // there is an edge to it, or back up
+	  if (ldigraph_has_edge(g, top->vertex, to))
+	    {
+	      *length = depth;
+	      return true;
+	    }
+	  depth--;
+	  if (depth == 0)
+	    {
+	      return true;
+	    }
+	  children_size = ps->stack[depth - 1].end;
+	}
+    }
+}
 
 
-ldigraph *ldigraph_create(size_t n)
+bool ldigraph_path_search_late(ldigraph_path_search *ps)
 {
-  if (n < 1)
+  // expansions may run a bounding search per child, so the clock is
+  // checked by edges examined rather than by expansions
+  if (ps->deadline > 0 && ps->edges_scanned >= ps->next_clock)
     {
-      return NULL;
+      ps->next_clock = ps->edges_scanned + LDIGRAPH_APPROX_CLOCK_INTERVAL;
+      return ldigraph_seconds() >= ps->deadline;
     }
+  return false;
+}
+
+
+bool ldigraph_path_search_parallel(ldigraph_path_search *ps, size_t from, size_t to, size_t limit, atomic_int *longest)
+{
+  const ldigraph *g = ps->g;
+  size_t threads = g->threads;
   
-  ldigraph *g = malloc(sizeof(ldigraph));
-  if (g != NULL)
+  ldigraph_path_pool pool;
+  pool.threads = threads;
+  pool.to = to;
+  pool.limit = limit;
+  pool.longest = longest;
+  atomic_init(&pool.pending, 0);
+  atomic_init(&pool.idle, 0);
+  atomic_init(&pool.failed, false);
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.wake, NULL);
+  pool.posted = 0;
+  pool.states = calloc(threads, sizeof(ldigraph_path_search *));
+  pool.deques = calloc(threads, sizeof(ldigraph_path_deque));
+  ldigraph_path_worker *workers = malloc(sizeof(ldigraph_path_worker) * threads);
+  pthread_t *ids = malloc(sizeof(pthread_t) * threads);
+  
+  // every worker has its own path but they share the in-edges and the
+  // vertices that can reach to
+  bool ok = pool.states != NULL && pool.deques != NULL && workers != NULL && ids != NULL;
+  size_t ready = 0;
+  while (ok && ready < threads)
     {
-      g->n = n;
-      g->list_size = malloc(sizeof(size_t) * n);
-      g->list_cap = malloc(sizeof(size_t) * n);
-      g->adj = malloc(sizeof(size_t *) * n);
-      
-      if (g->list_size == NULL || g->list_cap == NULL || g->adj == NULL)
+      pool.states[ready] = ready == 0 ? ps : ldigraph_path_search_create(g, ps);
+      if (pool.states[ready] == NULL)
 	{
-	  free(g->list_size);
-	  free(g->list_cap);
-	  free(g->adj);
-	  free(g);
-
-	  return NULL;
+	  ok = false;
 	}
-
-      for (size_t i = 0; i < n; i++)
+      else
 	{
-	  g->list_size[i] = 0;
-	  g->adj[i] = malloc(sizeof(size_t) * LDIGRAPH_ADJ_LIST_INITIAL_CAPACITY);
-	  g->list_cap[i] = g->adj[i] != NULL ? LDIGRAPH_ADJ_LIST_INITIAL_CAPACITY : 0;
+	  for (size_t w = 0; w < ps->words; w++)
+	    {
+	      pool.states[ready]->can_reach[w] = ps->can_reach[w];
+	    }
+	  pthread_mutex_init(&pool.deques[ready].lock, NULL);
+	  pool.deques[ready].tasks = NULL;
+	  pool.deques[ready].head = 0;
+	  pool.deques[ready].tail = 0;
+	  pool.deques[ready].cap = 0;
+	  workers[ready].pool = &pool;
+	  workers[ready].id = ready;
+	  ready++;
 	}
     }
 
-  return g;
-}
-
-
-size_t ldigraph_size(const ldigraph *g)
-{
-  if (g != NULL)
+  ldigraph_vertex *root = ok ? malloc(sizeof(ldigraph_vertex)) : NULL;
+  ok = root != NULL;
+  if (ok)
     {
-      return g->n;
+      root[0] = from;
+      ok = ldigraph_path_deque_push(&pool.deques[0], root, 1);
+      if (!ok)
+	{
+	  free(root);
+	}
     }
-  else
+  if (ok)
     {
-      return 0;
+      atomic_store(&pool.pending, 1);
+      
+      // the calling thread is worker 0; if fewer threads start, the ones
+      // that do share the work and the others' deques stay empty
+      size_t started = 1;
+      while (started < threads
+	     && pthread_create(&ids[started], NULL, ldigraph_path_worker_run, &workers[started]) == 0)
+	{
+	  started++;
+	}
+      ldigraph_path_worker_run(&workers[0]);
+      for (size_t t = 1; t < started; t++)
+	{
+	  pthread_join(ids[t], NULL);
+	}
+      ok = !atomic_load(&pool.failed);
     }
-}
-
 
-void ldigraph_list_embiggen(ldigraph *g, size_t from)
-{
-  if (g->list_cap[from] != 0)
+  for (size_t t = 0; t < ready; t++)
     {
-      g->adj[from] = realloc(g->adj[from], sizeof(size_t *) * g->list_cap[from] * 2);
-      g->list_cap[from] = g->adj[from] != NULL ? g->list_cap[from] * 2 : 0;
+      if (t > 0)
+	{
+	  ps->vertices_scanned += pool.states[t]->vertices_scanned;
+	  ps->edges_scanned += pool.states[t]->edges_scanned;
+	  ldigraph_path_search_destroy(pool.states[t]);
+	}
+      for (size_t i = pool.deques[t].head; i < pool.deques[t].tail; i++)
+	{
+	  free(pool.deques[t].tasks[i].path);
+	}
+      free(pool.deques[t].tasks);
+      pthread_mutex_destroy(&pool.deques[t].lock);
     }
+  pthread_cond_destroy(&pool.wake);
+  pthread_mutex_destroy(&pool.lock);
+  free(pool.states);
+  free(pool.deques);
+  free(workers);
+  free(ids);
+  
+  return ok;
 }
 
 
-void ldigraph_add_edge(ldigraph *g, size_t from, size_t to)
+void *ldigraph_path_worker_run(void *arg)
 {
-  if (g != NULL && from >= 0 && to >= 0 && from < g->n && to < g->n && from != to)
+  ldigraph_path_worker *worker = arg;
+  ldigraph_path_pool *pool = worker->pool;
+  size_t id = worker->id;
+  
+  while (true)
     {
-      // make room if necessary
-      if (g->list_size[from] == g->list_cap[from])
+      // note how many tasks there have been before looking, so that one
+      // made while looking is not slept through
+      pthread_mutex_lock(&pool->lock);
+      size_t seen = pool->posted;
+      pthread_mutex_unlock(&pool->lock);
+      
+      // take the newest task of our own, or steal the oldest of someone
+      // else's, which is likely to be the biggest
+      ldigraph_path_task task;
+      bool found = ldigraph_path_deque_pop(&pool->deques[id], &task, true);
+      for (size_t t = 1; !found && t < pool->threads; t++)
 	{
-	  ldigraph_list_embiggen(g, from);
+	  found = ldigraph_path_deque_pop(&pool->deques[(id + t) % pool->threads], &task, false);
 	}
 
-      // add to end of array if there is room
-      if (g->list_size[from] < g->list_cap[from])
+      if (found)
 	{
-	  g->adj[from][g->list_size[from]++] = to;
+	  int best = atomic_load(pool->longest);
+	  if ((best < 0 || (size_t)best < pool->limit) && !atomic_load(&pool->failed)
+	      && !ldigraph_path_search_extend(pool->states[id], task.path, task.length, pool->to, pool->limit,
+					      pool->longest, pool, id))
+	    {
+	      atomic_store(&pool->failed, true);
+	    }
+	  free(task.path);
+	  if (atomic_fetch_sub(&pool->pending, 1) == 1)
+	    {
+	      // that was the last task, so everyone waiting can stop
+	      ldigraph_path_pool_wake(pool, true);
+	    }
+	}
+      else
+	{
+	  // wait for a task or for the last one to finish, letting busy
+	  // workers know there is someone to hand work to
+	  pthread_mutex_lock(&pool->lock);
+	  atomic_fetch_add(&pool->idle, 1);
+	  while (pool->posted == seen && atomic_load(&pool->pending) > 0)
+	    {
+	      pthread_cond_wait(&pool->wake, &pool->lock);
+	    }
+	  atomic_fetch_sub(&pool->idle, 1);
+	  bool finished = atomic_load(&pool->pending) == 0;
+	  pthread_mutex_unlock(&pool->lock);
+	  if (finished)
+	    {
+	      return NULL;
+	    }
 	}
     }
 }
 
 
-bool ldigraph_has_edge(const ldigraph *g, size_t from, size_t to)
+bool ldigraph_path_pool_split(ldigraph_path_pool *pool, size_t id, const ldigraph_vertex *prefix, size_t base, const ldigraph_path_frame *stack, size_t depth, size_t next)
 {
-  if (g != NULL && from < g->n && to < g->n && from != to)
+  // the path to the new subtree is the prefix, the current path, and next
+  size_t length = base + depth + 1;
+  ldigraph_vertex *path = malloc(sizeof(ldigraph_vertex) * length);
+  if (path == NULL)
     {
-      // sequential search of from's adjacency list
-      size_t i = 0;
-      while (i < g->list_size[from] && g->adj[from][i] != to)
-	{
-	  i++;
-	}
-      return i < g->list_size[from];
+      return false;
     }
-  else
+  for (size_t i = 0; i < base; i++)
+    {
+      path[i] = prefix[i];
+    }
+  for (size_t i = 0; i < depth; i++)
+    {
+      path[base + i] = stack[i].vertex;
+    }
+  path[length - 1] = next;
+
+  atomic_fetch_add(&pool->pending, 1);
+  if (!ldigraph_path_deque_push(&pool->deques[id], path, length))
     {
+      atomic_fetch_sub(&pool->pending, 1);
+      free(path);
       return false;
     }
+  
+  ldigraph_path_pool_wake(pool, false);
+  return true;
 }
 
 
-int ldigraph_shortest_path(const ldigraph *g, size_t from, size_t to)
+void ldigraph_path_pool_wake(ldigraph_path_pool *pool, bool all)
 {
-  if (g == NULL || from >= g->n || to >= g->n)
+  pthread_mutex_lock(&pool->lock);
+  pool->posted++;
+  if (all)
     {
-      return -1;
+      pthread_cond_broadcast(&pool->wake);
+    }
+  else
+    {
+      pthread_cond_signal(&pool->wake);
     }
+  pthread_mutex_unlock(&pool->lock);
+}
 
-  // do BFS starting from the from vertex
-  ldigraph_search *s = ldigraph_bfs(g, from);
 
-  if (s != NULL)
+bool ldigraph_path_deque_push(ldigraph_path_deque *d, ldigraph_vertex *path, size_t length)
+{
+  pthread_mutex_lock(&d->lock);
+  if (d->tail == d->cap && d->head > 0)
     {
-      // look up the distance to the to vertex in the result and return it
-      int shortest = s->dist[to];
-      ldigraph_search_destroy(s);
-      return shortest;
+      // slide the tasks down over the ones that were stolen
+      for (size_t i = d->head; i < d->tail; i++)
+	{
+	  d->tasks[i - d->head] = d->tasks[i];
+	}
+      d->tail -= d->head;
+      d->head = 0;
     }
-  else
+  else if (d->tail == d->cap)
     {
-      return -1;
+      size_t cap = d->cap > 0 ? d->cap * 2 : LDIGRAPH_DFS_INITIAL_STACK;
+      ldigraph_path_task *bigger = realloc(d->tasks, sizeof(ldigraph_path_task) * cap);
+      if (bigger == NULL)
+	{
+	  pthread_mutex_unlock(&d->lock);
+	  return false;
+	}
+      d->tasks = bigger;
+      d->cap = cap;
     }
+  d->tasks[d->tail].path = path;
+  d->tasks[d->tail].length = length;
+  d->tail++;
+  pthread_mutex_unlock(&d->lock);
+  
+  return true;
 }
 
 
-ldigraph_search *ldigraph_bfs(const ldigraph *g, size_t from)
+bool ldigraph_path_deque_pop(ldigraph_path_deque *d, ldigraph_path_task *task, bool newest)
 {
-  // REPLACE THIS STUB!
-  return NULL;
+  pthread_mutex_lock(&d->lock);
+  bool found = d->head < d->tail;
+  if (found && newest)
+    {
+      *task = d->tasks[--d->tail];
+    }
+  else if (found)
+    {
+      *task = d->tasks[d->head++];
+    }
+  pthread_mutex_unlock(&d->lock);
+
+  return found;
 }
 
 
-int ldigraph_longest_path(const ldigraph *g, size_t from, size_t to)
+void ldigraph_atomic_max(atomic_int *x, int value)
 {
-  if (g == NULL || from >= g->n || to >= g->n)
+  int old = atomic_load_explicit(x, memory_order_relaxed);
+  while (old < value && !atomic_compare_exchange_weak_explicit(x, &old, value, memory_order_relaxed, memory_order_relaxed))
     {
-      return -1;
+      // old now holds the value another thread stored; try again
     }
+}
 
-  // do a DFS to determine if there is a cycle (need to modify DFS to
-  // find cycles)
-  ldigraph_search *s = ldigraph_dfs(g, from);
 
-  // If acyclic: do a version of DFS that keeps track, for each vertex v,
-  // of the longest simple path from v to the destination; update the
-  // length of the longest path every time you're finished looking at an
-  // edge, regardless of whether you traversed it or not
-  
-  // If cyclic: brute force search on cyclic graph starting from from vertex,
-  // going down all simple paths
+bool ldigraph_path_search_bound(ldigraph_path_search *ps, size_t v, size_t to, size_t *bound)
+{
+  const ldigraph *g = ps->g;
   
-  ldigraph_search_destroy(s);
+  // a new mark for this search; old marks must be cleared when the
+  // counter wraps around
+  ps->epoch++;
+  if (ps->epoch == 0)
+    {
+      for (size_t i = 0; i < g->n; i++)
+	{
+	  ps->stamp[i] = 0;
+	}
+      ps->epoch = 1;
+    }
 
-  // REMOVE THIS STUB WHEN DONE
-  return -1;
+  ps->stamp[v] = ps->epoch;
+  ps->queue[0] = v;
+  size_t tail = 1;
+  bool reached = false;
+  for (size_t head = 0; head < tail; head++)
+    {
+      size_t curr = ps->queue[head];
+      if (curr == to)
+	{
+	  // a simple path to to goes no further
+	  reached = true;
+	  continue;
+	}
+      
+      ldigraph_cursor edges;
+      size_t count = ldigraph_out_edges(g, curr, &edges);
+      ps->edges_scanned += count;
+      for (size_t i = 0; i < count; i++)
+	{
+	  size_t w = ldigraph_cursor_next(&edges);
+	  if (ps->stamp[w] != ps->epoch
+	      && !(ps->on_path[w / 64] & ((uint64_t)1 << (w % 64)))
+	      && (ps->can_reach[w / 64] & ((uint64_t)1 << (w % 64))))
+	    {
+	      ps->stamp[w] = ps->epoch;
+	      ps->queue[tail++] = w;
+	    }
+	}
+    }
+
+  *bound = tail - 1;
+  return reached;
 }
 
 
-ldigraph_search *ldigraph_dfs(const ldigraph *g, size_t from)
+int ldigraph_path_child_compare(const void *a, const void *b)
 {
-  if (g == NULL || from >= g->n)
+  const ldigraph_path_child *c1 = a;
+  const ldigraph_path_child *c2 = b;
+
+  // break ties by vertex so the order doesn't depend on qsort
+  if (c1->bound != c2->bound)
     {
-      return NULL;
+      return c1->bound > c2->bound ? -1 : 1;
     }
-
-  ldigraph_search *s = ldigraph_search_create(g);
-  if (s != NULL)
+  else if (c1->vertex != c2->vertex)
     {
-      // start at from
-      // (note we do not have the restart-if-some-vertices-unvisited
-      // loop here; consider whether you will need it)
-      s->dist[from] = 0;
-      ldigraph_dfs_visit(g, s, from);
+      return c1->vertex < c2->vertex ? -1 : 1;
+    }
+  else
+    {
+      return 0;
     }
-  return s;
 }
 
 
-ldigraph_search *ldigraph_dfs_with_restart(const ldigraph *g)
+void ldigraph_path_search_destroy(ldigraph_path_search *ps)
 {
-  if (g == NULL)
+  if (ps != NULL)
     {
-      return NULL;
+      free(ps->can_reach);
+      free(ps->on_path);
+      free(ps->stamp);
+      free(ps->queue);
+      free(ps->own_offset);
+      free(ps->own_sources);
+      free(ps->stack);
+      free(ps->children);
+      free(ps);
     }
+}
 
-  ldigraph_search *s = ldigraph_search_create(g);
-  if (s != NULL)
+
+bool ldigraph_dfs(const ldigraph *g, ldigraph_search *s, size_t from)
+{
+  ldigraph_search_init(s, g);
+  
+  // start at from
+  // (note we do not have the restart-if-some-vertices-unvisited
+  // loop here; consider whether you will need it)
+  ldigraph_search_reach(s, from, 0, LDIGRAPH_VERTEX_MAX);
+  s->finished = 0;
+  return ldigraph_dfs_visit(g, s, from);
+}
+
+
+bool ldigraph_dfs_with_restart(const ldigraph *g, ldigraph_search *s)
+{
+  ldigraph_search_init(s, g);
+  s->finished = 0;
+  
+  // try all starting points for DFS
+  for (size_t from = 0; from < g->n; from++)
     {
-      // try all starting points for DFS
-      for (size_t from = 0; from < g->n; from++)
+      // use from as a starting point if no previous search found it
+      if (ldigraph_search_color(s, from) == LDIGRAPH_UNSEEN)
 	{
-	  // use from as a starting point if no previous search found it
-	  if (s->color[from] == LDIGRAPH_UNSEEN)
+	  ldigraph_search_reach(s, from, 0, LDIGRAPH_VERTEX_MAX);
+	  if (!ldigraph_dfs_visit(g, s, from))
 	    {
-	      s->dist[from] = 0;
-	      ldigraph_dfs_visit(g, s, from);
+	      return false;
 	    }
 	}
     }
-  return s;
+
+  return true;
 }
 
 
-void ldigraph_dfs_visit(const ldigraph* g, ldigraph_search *s, size_t curr)
+bool ldigraph_dfs_visit(const ldigraph* g, ldigraph_search *s, size_t start)
 {
-  s->color[curr] = LDIGRAPH_PROCESSING;
+  // the caller has already reached start, so it is colored LDIGRAPH_PROCESSING
+  if (!ldigraph_search_reserve_stack(s, 1))
+    {
+      return false;
+    }
+  s->stack[0].vertex = start;
+  s->stack[0].next = 0;
+  size_t depth = 1;
+  size_t degree = ldigraph_out_edges(g, start, &s->stack[0].edges);
+  s->vertices_scanned++;
+  s->edges_scanned += degree;
 
-  // make alias for adjacency list for current vertex
-  const size_t *neighbors = g->adj[curr];
-  
-  // iterate over outgoing edges
-  for (size_t i = 0; i < g->list_size[curr]; i++)
+  while (depth > 0)
     {
-      size_t to = neighbors[i];
-      if (s->color[to] == LDIGRAPH_UNSEEN)
+      // make alias for adjacency list for the vertex on top of the stack
+      ldigraph_dfs_frame *top = &s->stack[depth - 1];
+      size_t curr = top->vertex;
+      size_t count = ldigraph_out_degree(g, curr);
+
+      // resume iterating over outgoing edges where we left off
+      bool found = false;
+      size_t to = curr;
+      while (!found && top->next < count)
+	{
+	  to = ldigraph_cursor_next(&top->edges);
+	  top->next++;
+	  found = ldigraph_search_color(s, to) == LDIGRAPH_UNSEEN;
+	}
+      
+      if (found)
 	{
 	  // found an edge to a new vertex -- explore it
-	  s->dist[to] = s->dist[curr] + 1;
-	  s->pred[to] = curr;
-	  
-	  ldigraph_dfs_visit(g, s, to);
+	  ldigraph_search_reach(s, to, s->dist[curr] + 1, curr);
+	  if (!ldigraph_search_reserve_stack(s, depth + 1))
+	    {
+	      return false;
+	    }
+	  s->stack[depth].vertex = to;
+	  s->stack[depth].next = 0;
+	  degree = ldigraph_out_edges(g, to, &s->stack[depth].edges);
+	  depth++;
+	  s->vertices_scanned++;
+	  s->edges_scanned += degree;
+	}
+      else
+	{
+	  // mark and record current vertex finished
+	  s->color[curr] = LDIGRAPH_DONE;
+	  s->queue[s->finished++] = curr;
+	  depth--;
 	}
     }
-  
-  // mark and record current vertex finished
-  s->color[curr] = LDIGRAPH_DONE;
+
+  return true;
 }
 
 
@@ -331,63 +7187,216 @@ void ldigraph_destroy(ldigraph *g)
 {
   if (g != NULL)
     {
-      for (size_t i = 0; i < g->n; i++)
+      if (!g->frozen)
 	{
-	  free(g->adj[i]);
+	  for (size_t i = 0; i < g->n; i++)
+	    {
+	      free(g->adj[i]);
+	    }
 	}
       free(g->adj);
       free(g->list_cap);
       free(g->list_size);
+      if (g->index != NULL)
+	{
+	  for (size_t i = 0; i < g->n; i++)
+	    {
+	      ldigraph_index_destroy(g->index[i]);
+	    }
+	}
+      free(g->index);
+      if (!ldigraph_is_mapped(g, g->offset))
+	{
+	  free(g->offset);
+	  free(g->targets);
+	}
+      if (!ldigraph_is_mapped(g, g->in_offset))
+	{
+	  free(g->in_offset);
+	  free(g->sources);
+	}
+      free(g->packed);
+      free(g->packed_offset);
+      free(g->in_packed);
+      free(g->in_packed_offset);
+      free(g->order);
+      free(g->position);
+      if (!ldigraph_is_mapped(g, g->component))
+	{
+	  free(g->component);
+	  free(g->local);
+	  free(g->component_offset);
+	  free(g->members);
+	}
+      if (!ldigraph_is_mapped(g, g->reach_low))
+	{
+	  free(g->reach_low);
+	  free(g->reach_post);
+	}
+      ldigraph_labels_clear(g);
+      free(g->landmark_dist);
+      if (g->mapping != NULL)
+	{
+	  munmap(g->mapping, g->mapping_size);
+	}
       free(g);
     }
 }
 
 
-ldigraph_search *ldigraph_search_create(const ldigraph *g)
+ldigraph_search *ldigraph_search_create(size_t cap)
 {
-  if (g != NULL)
+  ldigraph_search *s = malloc(sizeof(ldigraph_search));
+  if (s != NULL)
     {
-      ldigraph_search *s = malloc(sizeof(ldigraph_search));
-      
-      if (s != NULL)
-	{
-	  s->g = g;
-	  s->color = malloc(sizeof(int) * g->n);
-	  s->dist = malloc(sizeof(int) * g->n);
-	  s->pred = malloc(sizeof(int) * g->n);
+      s->g = NULL;
+      s->cap = 0;
+      s->epoch = 0;
+      s->stamp = NULL;
+      s->color = NULL;
+      s->dist = NULL;
+      s->pred = NULL;
+      s->queue = NULL;
+      s->frontier = NULL;
+      s->next = NULL;
+      s->stack = NULL;
+      s->stack_cap = 0;
+      s->finished = 0;
+      s->vertices_scanned = 0;
+      s->edges_scanned = 0;
 
-	  if (s->color != NULL && s->dist != NULL && s->pred != NULL)
-	    {
-	      ldigraph_search_init(s);
-	    }
-	  else
-	    {
-	      free(s->pred);
-	      free(s->dist);
-	      free(s->color);
-	      free(s);
-	      return NULL;
-	    }
+      if (!ldigraph_search_reserve(s, cap))
+	{
+	  ldigraph_search_destroy(s);
+	  return NULL;
 	}
+    }
+
+  return s;
+}
+
+
+bool ldigraph_search_reserve(ldigraph_search *s, size_t cap)
+{
+  if (cap <= s->cap)
+    {
+      return true;
+    }
+
+  // the old contents are not needed, so start over rather than realloc
+  free(s->stamp);
+  free(s->color);
+  free(s->dist);
+  free(s->pred);
+  free(s->queue);
+  free(s->frontier);
+  free(s->next);
+  
+  s->stamp = calloc(cap, sizeof(uint32_t));
+  s->color = malloc(sizeof(unsigned char) * cap);
+  s->dist = malloc(sizeof(int) * cap);
+  s->pred = malloc(sizeof(ldigraph_vertex) * cap);
+  s->queue = malloc(sizeof(ldigraph_vertex) * cap);
+  s->frontier = malloc(sizeof(uint64_t) * ((cap + 63) / 64));
+  s->next = malloc(sizeof(uint64_t) * ((cap + 63) / 64));
+  s->epoch = 0;
 
-      return s;
+  if (s->stamp == NULL || s->color == NULL || s->dist == NULL || s->pred == NULL || s->queue == NULL
+      || s->frontier == NULL || s->next == NULL)
+    {
+      s->cap = 0;
+      return false;
     }
-  else
+  
+  s->cap = cap;
+  return true;
+}
+
+
+bool ldigraph_search_reserve_stack(ldigraph_search *s, size_t frames)
+{
+  if (frames <= s->stack_cap)
     {
-      return NULL;
+      return true;
+    }
+
+  size_t cap = s->stack_cap > 0 ? s->stack_cap * 2 : LDIGRAPH_DFS_INITIAL_STACK;
+  if (cap < frames)
+    {
+      cap = frames;
     }
+  
+  ldigraph_dfs_frame *bigger = realloc(s->stack, sizeof(ldigraph_dfs_frame) * cap);
+  if (bigger == NULL)
+    {
+      return false;
+    }
+
+  s->stack = bigger;
+  s->stack_cap = cap;
+  return true;
+}
+
+
+void ldigraph_search_init(ldigraph_search *s, const ldigraph *g)
+{
+  s->g = g;
+  
+  // all vertices are unseen in the new generation; stamps from the
+  // previous use of the current generation number must be cleared
+  // when the counter wraps around
+  s->epoch++;
+  if (s->epoch == 0)
+    {
+      for (size_t i = 0; i < s->cap; i++)
+	{
+	  s->stamp[i] = 0;
+	}
+      s->epoch = 1;
+    }
+}
+
+
+int ldigraph_search_color(const ldigraph_search *s, size_t v)
+{
+  // unseen targets are stamped with color LDIGRAPH_UNSEEN
+  return s->stamp[v] == s->epoch ? s->color[v] : LDIGRAPH_UNSEEN;
+}
+
+
+int ldigraph_search_dist(const ldigraph_search *s, size_t v)
+{
+  // unseen targets are stamped with distance -1
+  return s->stamp[v] == s->epoch ? s->dist[v] : -1; // -1 for no path yet
 }
 
 
-void ldigraph_search_init(ldigraph_search *s)
+bool ldigraph_search_mark_target(ldigraph_search *s, size_t v)
 {
-  // initialize all vertices to unseen
-  for (size_t i = 0; i < s->g->n; i++)
+  if (s->stamp[v] == s->epoch)
     {
-      s->color[i] = LDIGRAPH_UNSEEN;
-      s->dist[i] = -1; // -1 for no path yet
-      s->pred[i] = -1; // no predecessor yet
+      return false;
     }
+
+  s->stamp[v] = s->epoch;
+  s->color[v] = LDIGRAPH_UNSEEN;
+  s->dist[v] = -1;
+  return true;
+}
+
+
+bool ldigraph_search_is_target(const ldigraph_search *s, size_t v)
+{
+  return s->stamp[v] == s->epoch;
+}
+
+
+void ldigraph_search_reach(ldigraph_search *s, size_t v, int dist, size_t pred)
+{
+  s->stamp[v] = s->epoch;
+  s->color[v] = LDIGRAPH_PROCESSING;
+  s->dist[v] = dist;
+  s->pred[v] = pred;
 }
 
 
@@ -395,9 +7404,14 @@ void ldigraph_search_destroy(ldigraph_search *s)
 {
   if (s != NULL)
     {
+      free(s->stamp);
       free(s->color);
       free(s->dist);
       free(s->pred);
+      free(s->queue);
+      free(s->frontier);
+      free(s->next);
+      free(s->stack);
       free(s);
     }
 }
@@ -3,19 +3,190 @@
 
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * The width of the vertex numbers stored in adjacency lists and search
+ * results, chosen at compile time with -DLDIGRAPH_VERTEX_BITS=32 (the
+ * default) or 64.  Graphs are limited to LDIGRAPH_VERTEX_MAX vertices;
+ * vertex numbers passed to and returned from functions are size_t
+ * regardless.
+ */
+#ifndef LDIGRAPH_VERTEX_BITS
+#define LDIGRAPH_VERTEX_BITS 32
+#endif
+
+#if LDIGRAPH_VERTEX_BITS == 32
+typedef uint32_t ldigraph_vertex;
+#define LDIGRAPH_VERTEX_MAX UINT32_MAX
+#elif LDIGRAPH_VERTEX_BITS == 64
+typedef uint64_t ldigraph_vertex;
+#define LDIGRAPH_VERTEX_MAX UINT64_MAX
+#else
+#error "LDIGRAPH_VERTEX_BITS must be 32 or 64"
+#endif
 
 typedef struct ldigraph ldigraph;
 
+// the first bytes of a graph file written by ldigraph_save
+#define LDIGRAPH_FILE_MAGIC "LDIGRAPH"
+
+/**
+ * Ways of answering shortest path queries.  Engines that walk edges
+ * backwards are only used once the graph has in-edges; until then
+ * every engine falls back to LDIGRAPH_SHORTEST_BFS.  LDIGRAPH_SHORTEST_ALT
+ * also needs landmarks (see ldigraph_build_landmarks) and is treated as
+ * LDIGRAPH_SHORTEST_AUTO without them.
+ */
+typedef enum
+{
+  LDIGRAPH_SHORTEST_AUTO,           // the best engine for the graph (default)
+  LDIGRAPH_SHORTEST_BFS,            // BFS from the start until the end is reached
+  LDIGRAPH_SHORTEST_BIDIRECTIONAL,  // BFS from both ends until they meet
+  LDIGRAPH_SHORTEST_DIRECTION_OPTIMIZING, // BFS that goes bottom-up on large levels
+  LDIGRAPH_SHORTEST_ALT             // A* search with bounds from landmarks
+} ldigraph_shortest_engine;
+
+/**
+ * Ways of renumbering the vertices of a graph with ldigraph_reorder so
+ * that vertices searched together are stored together.  All but
+ * LDIGRAPH_REORDER_DEGREE treat edges as going both ways.
+ */
+typedef enum
+{
+  LDIGRAPH_REORDER_BFS,    // breadth-first order from each unnumbered vertex
+  LDIGRAPH_REORDER_RCM,    // reverse Cuthill-McKee: breadth-first from a
+                           // low-degree vertex, lower degrees first, reversed
+  LDIGRAPH_REORDER_DEGREE, // highest degree (in plus out) first
+  LDIGRAPH_REORDER_GORDER  // greedily next to the recently numbered vertices
+                           // it shares the most edges and in-neighbors with
+} ldigraph_reorder_strategy;
+
+/**
+ * Scratch space for searches, so that repeated queries do not allocate
+ * and initialize per-vertex arrays every time.  A workspace may be used
+ * with any number of graphs, one search at a time, so each thread
+ * should have its own.
+ */
+typedef struct ldigraph_workspace ldigraph_workspace;
+
+typedef struct
+{
+  double seconds;    // wall-clock time a search may take, or 0 for no limit
+  size_t expansions; // vertices a search may expand, or 0 for no limit
+} ldigraph_longest_budget;
+
+/**
+ * Counts the work done by the searches run in a workspace.
+ */
+typedef struct
+{
+  size_t vertices; // vertices whose outgoing (or incoming) edges were examined
+  size_t edges;    // edges examined
+} ldigraph_search_stats;
+
+/**
+ * Controls how adjacency lists are indexed for ldigraph_has_edge.  Lists
+ * shorter than index_threshold are searched sequentially.  Longer lists
+ * get a hash index, or a bitset with one bit per vertex if the list
+ * holds at least bitset_density times the number of vertices.  An
+ * index_threshold of 0 turns indexing off.  Indices are kept alongside
+ * the lists, so neighbors are still visited in insertion order.
+ */
+typedef struct
+{
+  size_t index_threshold;
+  double bitset_density;
+} ldigraph_adjacency_config;
+
+/**
+ * Reports how many adjacency lists use each representation and how much
+ * memory the indices take.
+ */
+typedef struct
+{
+  size_t linear;      // lists searched sequentially
+  size_t hashed;      // lists with a hash index
+  size_t bitset;      // lists with a bitset index
+  size_t index_bytes; // total size of all indices
+} ldigraph_adjacency_stats;
+
 /**
  * Creates a new directed graph with the given number of vertices.  The
  * vertices will be numbered 0, ..., n-1.
  *
- * @param n a positive integer
+ * @param n a positive integer no greater than LDIGRAPH_VERTEX_MAX
  * @return a pointer to the new graph
  */
 ldigraph *ldigraph_create(size_t n);
 
 
+/**
+ * Creates a new directed graph with the given number of vertices and
+ * the given edges, where edge i goes from from[i] to to[i].  Edges that
+ * ldigraph_add_edge would ignore (endpoints out of range or equal) are
+ * skipped, and so are repeats of an edge given earlier in the list.  The
+ * graph is built directly in frozen form, with each adjacency list in
+ * the order its edges first appear in the input.
+ *
+ * @param n a positive integer no greater than LDIGRAPH_VERTEX_MAX
+ * @param from an array of m vertex indices, non-NULL if m > 0
+ * @param to an array of m vertex indices, non-NULL if m > 0
+ * @param m the number of edges
+ * @return a pointer to the new graph, or NULL if it could not be created
+ */
+ldigraph *ldigraph_create_from_edges(size_t n, const ldigraph_vertex *from, const ldigraph_vertex *to, size_t m);
+
+
+/**
+ * Writes the given graph to the given file in the binary format read by
+ * ldigraph_map: a header giving the format version, type sizes, and
+ * section positions, then the out-edge offsets and targets in the same
+ * packed form as a frozen graph, then sections for in-edges and the
+ * reachability index if the graph has them.  Files start with
+ * LDIGRAPH_FILE_MAGIC and can only be mapped where ldigraph_vertex and
+ * size_t have the same sizes as where they were written.
+ *
+ * @param g a pointer to a directed graph
+ * @param filename the name of the file to write, non-NULL
+ * @return true if successful, false if the file could not be written
+ */
+bool ldigraph_save(const ldigraph *g, const char *filename);
+
+
+/**
+ * Creates a frozen graph that uses a file written by ldigraph_save in
+ * place by mapping it into memory, so loading takes time independent of
+ * the size of the graph and pages are read as searches touch them.
+ * In-edges and a reachability index saved with the graph are used in
+ * place too.  Only the header and the ends of the sections are checked,
+ * so the file must come from ldigraph_save and must not be modified
+ * while it is mapped.  Adjacency lists are not indexed until
+ * ldigraph_set_adjacency_config is called.
+ *
+ * @param filename the name of a file, non-NULL
+ * @return a pointer to the new graph, or NULL if the file could not be
+ * mapped or is not a graph file for this machine
+ */
+ldigraph *ldigraph_map(const char *filename);
+
+
+/**
+ * Creates a frozen graph from a file written by ldigraph_save as
+ * ldigraph_map does, after checking every section: the offsets must
+ * never decrease, every vertex number must be in range, the in-edges
+ * must match the edges, and the components must list every vertex once
+ * and agree with the edges.  This reads the whole file, so it takes time
+ * linear in the size of the graph, but a damaged or hostile file is
+ * rejected instead of making searches read outside the graph.
+ *
+ * @param filename the name of a file, non-NULL
+ * @return a pointer to the new graph, or NULL if the file could not be
+ * mapped or is not a valid graph file for this machine
+ */
+ldigraph *ldigraph_map_checked(const char *filename);
+
+
 /**
  * Returns the number of vertices in the given graph.
  *
@@ -27,7 +198,8 @@ size_t ldigraph_size(const ldigraph *g);
 
 /**
  * Adds the given directed edge to this graph.  The edge must
- * not already be present in the graph.
+ * not already be present in the graph.  Has no effect if the graph
+ * has been frozen.
  *
  * @param g a pointer to a directed graph, non-NULL
  * @param from a valid vertex index in g
@@ -36,6 +208,205 @@ size_t ldigraph_size(const ldigraph *g);
 void ldigraph_add_edge(ldigraph *g, size_t from, size_t to);
 
 
+/**
+ * Packs the adjacency lists of the given graph into a single array of
+ * edge targets indexed by an array of per-vertex offsets (compressed
+ * sparse row form).  Neighbors keep the order their edges were added.
+ * After this the graph is read-only: further calls to ldigraph_add_edge
+ * are ignored, while all queries run on the packed arrays.  Freezing an
+ * already frozen graph does nothing.  If there is not enough memory
+ * the graph is left unchanged.
+ *
+ * @param g a pointer to a directed graph
+ * @return true if and only if the graph is now frozen
+ */
+bool ldigraph_freeze(ldigraph *g);
+
+
+/**
+ * Builds lists of incoming edges for every vertex of the given graph,
+ * freezing it first if necessary.  Once the graph has in-edges,
+ * ldigraph_shortest_path searches from both ends at once unless another
+ * engine has been selected with ldigraph_set_shortest_engine.  Building
+ * in-edges for a graph that already has them does nothing.  If there
+ * is not enough memory the graph is left without in-edges.
+ *
+ * @param g a pointer to a directed graph
+ * @return true if and only if the graph now has in-edges
+ */
+bool ldigraph_build_in_edges(ldigraph *g);
+
+
+/**
+ * Compresses the adjacency lists of the given graph, and its in-edges
+ * now or whenever they are built, freezing it first if necessary.  Each
+ * list is kept as the differences between consecutive neighbors in
+ * variable-length bytes, which searches decode as they go; for graphs
+ * whose neighbors tend to have nearby numbers this takes a fraction of
+ * the space of the packed arrays.  If sorted is true each list is sorted
+ * first, which makes the differences smaller but changes the order in
+ * which searches consider neighbors, and so which of several equally
+ * good paths they find.  Compressing a compressed graph does nothing.
+ * If there is not enough memory the graph is left unchanged.
+ *
+ * @param g a pointer to a directed graph
+ * @param sorted true to sort each list, false to keep the order the
+ * edges were added in
+ * @return true if and only if the graph is now compressed
+ */
+bool ldigraph_compress(ldigraph *g, bool sorted);
+
+
+/**
+ * Returns the number of bytes the given graph uses for its adjacency
+ * lists and in-edges, counting the offsets into them.
+ *
+ * @param g a pointer to a directed graph
+ * @return the number of bytes in the graph's edge lists
+ */
+size_t ldigraph_edge_bytes(const ldigraph *g);
+
+
+/**
+ * Creates a copy of the given graph with its vertices renumbered by the
+ * given strategy, so that searches touch fewer distinct parts of memory.
+ * Vertex v of g is vertex (*forward)[v] of the copy, and vertex w of the
+ * copy is vertex (*inverse)[w] of g; path lengths are the same in both.
+ * Each adjacency list keeps the order of the original.  The copy is
+ * frozen and has the same adjacency configuration, shortest path engine,
+ * and thread count as g, but no in-edges, indices, or compression, which
+ * can be built for it as for any graph.  The caller is responsible for
+ * destroying the copy and freeing both arrays.
+ *
+ * @param g a pointer to a directed graph
+ * @param strategy how to choose the new numbers
+ * @param forward a pointer to a location to store the new number of each
+ * vertex, non-NULL
+ * @param inverse a pointer to a location to store the old number of each
+ * vertex, non-NULL
+ * @return a pointer to the renumbered graph, or NULL if there was not
+ * enough memory, in which case nothing is stored in forward or inverse
+ */
+ldigraph *ldigraph_reorder(const ldigraph *g, ldigraph_reorder_strategy strategy, ldigraph_vertex **forward, ldigraph_vertex **inverse);
+
+
+/**
+ * Builds an index that answers most "is there no path?" questions about
+ * the given graph in constant time, freezing it first if necessary.  The
+ * strongly connected components are numbered in topological order and
+ * each gets a few nested interval labels from depth-first searches of
+ * the graph of components, so the index takes linear space.  Once the
+ * graph has an index, shortest and longest path queries between
+ * vertices it rules out return -1 without searching.  The index needs
+ * a frozen graph, so it lasts until the graph is destroyed.
+ *
+ * @param g a pointer to a directed graph
+ * @return true if and only if the graph now has a reachability index
+ */
+bool ldigraph_build_reachability(ldigraph *g);
+
+
+/**
+ * Determines whether there is a path from the given vertex to the given
+ * vertex.  With a reachability index, pairs it rules out are answered
+ * at once and others by a search that skips vertices it rules out.  The
+ * search uses the calling thread's workspace, as ldigraph_shortest_path
+ * does.
+ *
+ * @param g a pointer to a directed graph
+ * @param from a valid vertex index in g
+ * @param to a valid vertex index in g
+ * @return true if and only if there is a path from from to to
+ */
+bool ldigraph_reachable(const ldigraph *g, size_t from, size_t to);
+
+
+/**
+ * Determines whether there is a path from the given vertex to the given
+ * vertex, using the given workspace for any search.
+ *
+ * @param g a pointer to a directed graph
+ * @param from a valid vertex index in g
+ * @param to a valid vertex index in g
+ * @param ws a pointer to a workspace, non-NULL
+ * @return true if and only if there is a path from from to to, false if
+ * not or if there was not enough memory
+ */
+bool ldigraph_reachable_with(const ldigraph *g, size_t from, size_t to, ldigraph_workspace *ws);
+
+
+/**
+ * Builds a 2-hop labeling of the given graph, freezing it and adding
+ * in-edges first if necessary.  Each vertex gets a label of hubs it has
+ * paths to and a label of hubs with paths to it, with the distances,
+ * so that once the graph has a labeling shortest path queries are
+ * answered by merging two short sorted lists instead of by searching.
+ * The labels come from pruned breadth-first searches from every vertex
+ * in decreasing order of degree; with more than one thread (see
+ * ldigraph_set_threads), the searches run in batches of one per thread.
+ * The labeling lasts until the graph is destroyed.  Building a labeling
+ * for a graph that already has one does nothing.
+ *
+ * @param g a pointer to a directed graph
+ * @return true if and only if the graph now has a labeling
+ */
+bool ldigraph_build_labels(ldigraph *g);
+
+
+/**
+ * Returns the number of entries in the labels of the given graph's
+ * 2-hop labeling.
+ *
+ * @param g a pointer to a directed graph
+ * @return the number of entries, or 0 if the graph has no labeling
+ */
+size_t ldigraph_label_count(const ldigraph *g);
+
+
+/**
+ * Writes the given graph's 2-hop labeling to the given file so that it
+ * can be loaded instead of built again.  The file records the size and
+ * a hash of the graph's edges.
+ *
+ * @param g a pointer to a directed graph with a labeling
+ * @param filename the name of the file to write, non-NULL
+ * @return true if successful, false if the graph has no labeling or the
+ * file could not be written
+ */
+bool ldigraph_save_labels(const ldigraph *g, const char *filename);
+
+
+/**
+ * Reads a 2-hop labeling for the given graph from the given file,
+ * freezing the graph first if necessary.  A file saved for a different
+ * graph, or on a machine with different type sizes, is rejected.
+ *
+ * @param g a pointer to a directed graph
+ * @param filename the name of a file written by ldigraph_save_labels
+ * @return true if the graph now has the labeling from the file, false
+ * if the file could not be read or does not fit the graph
+ */
+bool ldigraph_load_labels(ldigraph *g, const char *filename);
+
+
+/**
+ * Chooses landmarks for the LDIGRAPH_SHORTEST_ALT engine and finds the
+ * distances from and to each of them with breadth-first search, adding
+ * in-edges to the given graph first if necessary.  The landmarks are
+ * chosen one at a time, each as far as possible from the ones before.
+ * The distances take 2 * count entries per vertex.  Building landmarks
+ * again replaces the old ones, and otherwise they last until the graph
+ * is destroyed.
+ *
+ * @param g a pointer to a directed graph
+ * @param count the number of landmarks, positive; graphs with fewer
+ * vertices get one per vertex
+ * @return true if successful, false for invalid arguments or if there
+ * was not enough memory
+ */
+bool ldigraph_build_landmarks(ldigraph *g, size_t count);
+
+
 /**
  * Determines if the given graph contains an edge from the given
  * from vertex to the given to vertex.
@@ -48,10 +419,45 @@ void ldigraph_add_edge(ldigraph *g, size_t from, size_t to);
 bool ldigraph_has_edge(const ldigraph *g, size_t from, size_t to);
 
 
+/**
+ * Changes the thresholds at which adjacency lists of the given graph are
+ * indexed and rebuilds the indices to match.  New graphs start with an
+ * index threshold of 32 and a bitset density of 1/64.
+ *
+ * @param g a pointer to a directed graph
+ * @param config the new thresholds
+ */
+void ldigraph_set_adjacency_config(ldigraph *g, ldigraph_adjacency_config config);
+
+
+/**
+ * Returns the thresholds at which adjacency lists of the given graph are
+ * indexed.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @return the current thresholds
+ */
+ldigraph_adjacency_config ldigraph_get_adjacency_config(const ldigraph *g);
+
+
+/**
+ * Returns counts of the adjacency list representations in use in the
+ * given graph.
+ *
+ * @param g a pointer to a directed graph
+ * @return the counts for that graph
+ */
+ldigraph_adjacency_stats ldigraph_adjacency_report(const ldigraph *g);
+
+
 /**
  * Returns the length of the shortest path from the given vertex
  * to the given vertex.  If there is no path then the return value
- * is -1.
+ * is -1.  Graphs with a 2-hop labeling answer from their labels.
+ * The search uses a workspace kept for the calling thread and destroyed
+ * when the thread exits, so only a thread's first query allocates
+ * memory for every vertex.  Use ldigraph_shortest_path_with to manage
+ * the workspace yourself.
  *
  * @param g a pointer to a directed graph, non-NULL
  * @param from a valid vertex index in g
@@ -61,10 +467,142 @@ bool ldigraph_has_edge(const ldigraph *g, size_t from, size_t to);
 int ldigraph_shortest_path(const ldigraph *g, size_t from, size_t to);
 
 
+/**
+ * Returns the length of the shortest path from the given vertex
+ * to the given vertex, using the given workspace for the search so
+ * that the cost depends only on the part of the graph that is explored.
+ * If there is no path then the return value is -1.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param from a valid vertex index in g
+ * @param to a valid vertex index in g
+ * @param ws a pointer to a workspace, non-NULL
+ * @return the length of the shortest path, or -1
+ */
+int ldigraph_shortest_path_with(const ldigraph *g, size_t from, size_t to, ldigraph_workspace *ws);
+
+
+/**
+ * Finds the lengths of the shortest paths from the given vertex to each
+ * of the given target vertices with a single breadth-first search that
+ * stops as soon as every target has been reached.  The length for a
+ * target with no path is -1.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param from a valid vertex index in g
+ * @param targets an array of target_count valid vertex indices in g
+ * @param target_count the number of targets
+ * @param lengths an array with room for target_count lengths
+ * @param ws a pointer to a workspace, non-NULL
+ * @return true if successful, false for invalid arguments or if
+ * there was not enough memory
+ */
+bool ldigraph_shortest_paths_from(const ldigraph *g, size_t from, const size_t *targets, size_t target_count, int *lengths, ldigraph_workspace *ws);
+
+
+/**
+ * Fills the given array with the length of the shortest path from the
+ * given vertex to every vertex, or -1 for vertices with no path.  If
+ * the graph has been allowed more than one thread this uses
+ * ldigraph_distances_parallel.  Otherwise, if the graph has in-edges
+ * this uses direction-optimizing BFS, unless the graph's shortest path
+ * engine is LDIGRAPH_SHORTEST_BFS.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param from a valid vertex index in g
+ * @param dist an array with room for ldigraph_size(g) lengths
+ * @return true if successful, false for invalid arguments or if
+ * there was not enough memory
+ */
+bool ldigraph_distances_from(const ldigraph *g, size_t from, int *dist);
+
+
+/**
+ * Fills the given array with the length of the shortest path from the
+ * given vertex to every vertex, or -1 for vertices with no path, using
+ * a breadth-first search whose levels are expanded by the given number
+ * of threads.  The distances are the same as with one thread.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param from a valid vertex index in g
+ * @param dist an array with room for ldigraph_size(g) lengths
+ * @param threads the number of threads to use
+ * @return true if successful, false for invalid arguments or if
+ * there was not enough memory or threads could not be started
+ */
+bool ldigraph_distances_parallel(const ldigraph *g, size_t from, int *dist, size_t threads);
+
+
+/**
+ * Sets the number of threads that searches of the given graph may use.
+ * New graphs use one.
+ *
+ * @param g a pointer to a directed graph
+ * @param threads a positive integer
+ */
+void ldigraph_set_threads(ldigraph *g, size_t threads);
+
+
+/**
+ * Returns the number of threads that searches of the given graph may use.
+ *
+ * @param g a pointer to a directed graph
+ * @return the number of threads
+ */
+size_t ldigraph_get_threads(const ldigraph *g);
+
+
+/**
+ * Answers a batch of shortest path queries, where query i asks for the
+ * length of the shortest path from from[i] to to[i], and stores the
+ * answers in lengths.  Queries are grouped by start vertex and up to 64
+ * start vertices share each breadth-first sweep over the graph, so a
+ * large batch costs far fewer traversals than asking each query
+ * separately.  The answer to a query with an invalid vertex or with
+ * no path is -1.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param from an array of count vertex indices
+ * @param to an array of count vertex indices
+ * @param count the number of queries
+ * @param lengths an array with room for count lengths
+ * @param ws a pointer to a workspace, non-NULL
+ * @return true if successful, false for invalid arguments or if
+ * there was not enough memory
+ */
+bool ldigraph_shortest_paths_batch(const ldigraph *g, const size_t *from, const size_t *to, size_t count, int *lengths, ldigraph_workspace *ws);
+
+
+/**
+ * Selects how shortest path queries on the given graph are answered.
+ *
+ * @param g a pointer to a directed graph
+ * @param engine the engine to use
+ */
+void ldigraph_set_shortest_engine(ldigraph *g, ldigraph_shortest_engine engine);
+
+
+/**
+ * Returns the engine used for shortest path queries on the given graph.
+ *
+ * @param g a pointer to a directed graph
+ * @return the engine for that graph
+ */
+ldigraph_shortest_engine ldigraph_get_shortest_engine(const ldigraph *g);
+
+
 /**
  * Returns the length of the longest simple path from the given vertex
  * to the given vertex.  If there is no path then the return value
- * is -1.
+ * is -1.  Once the graph has been prepared with ldigraph_prepare_longest,
+ * queries on an acyclic graph take linear time and queries on a cyclic
+ * graph work through its strongly connected components.  On a graph
+ * that has not been prepared, a query takes time linear in the part of
+ * the graph reachable from the start if that part is acyclic, and
+ * otherwise searches the whole graph, which can take exponential time.
+ * Searches of large cyclic regions use as many threads as the graph
+ * allows.  The calling thread's workspace is used, as in
+ * ldigraph_shortest_path.
  *
  * @param g a pointer to a directed graph, non-NULL
  * @param from a valid vertex index in g
@@ -74,6 +612,110 @@ int ldigraph_shortest_path(const ldigraph *g, size_t from, size_t to);
 int ldigraph_longest_path(const ldigraph *g, size_t from, size_t to);
 
 
+/**
+ * Returns the length of the longest simple path from the given vertex
+ * to the given vertex, using the given workspace for the search.  If
+ * there is no path then the return value is -1.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param from a valid vertex index in g
+ * @param to a valid vertex index in g
+ * @param ws a pointer to a workspace, non-NULL
+ * @return the length of the longest simple path, or -1
+ */
+int ldigraph_longest_path_with(const ldigraph *g, size_t from, size_t to, ldigraph_workspace *ws);
+
+
+/**
+ * Returns the length of the longest simple path from the given vertex
+ * to the given vertex that can be found within the given budget.  On a
+ * cyclic graph the answer starts as the length of the shortest path.  It
+ * is then improved by depth-first dives, one greedy and the rest in
+ * random orders, that share the first half of the budget, and by the
+ * exact search with the rest.  If the exact search finishes, or a path
+ * that can't be beaten is found, the answer is exact; otherwise it is a
+ * lower bound.  If there is no path the return value is -1.  The calling
+ * thread's workspace is used, as in ldigraph_shortest_path.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param from a valid vertex index in g
+ * @param to a valid vertex index in g
+ * @param budget the time and number of vertex expansions allowed
+ * @param is_exact a pointer to a location to store whether the answer
+ * is known to be exact, non-NULL
+ * @return the length of the longest simple path found, or -1
+ */
+int ldigraph_longest_path_budgeted(const ldigraph *g, size_t from, size_t to, ldigraph_longest_budget budget, bool *is_exact);
+
+
+/**
+ * Returns the length of the longest simple path from the given vertex
+ * to the given vertex that can be found within the given budget, using
+ * the given workspace for the search.  See ldigraph_longest_path_budgeted.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param from a valid vertex index in g
+ * @param to a valid vertex index in g
+ * @param budget the time and number of vertex expansions allowed
+ * @param is_exact a pointer to a location to store whether the answer
+ * is known to be exact, non-NULL
+ * @param ws a pointer to a workspace, non-NULL
+ * @return the length of the longest simple path found, or -1
+ */
+int ldigraph_longest_path_budgeted_with(const ldigraph *g, size_t from, size_t to, ldigraph_longest_budget budget, bool *is_exact, ldigraph_workspace *ws);
+
+
+/**
+ * Freezes the given graph if necessary and finds what longest path
+ * queries on it use: whether it is acyclic, a topological order if it
+ * is, and its strongly connected components if it is not.  These are
+ * kept until the graph is destroyed.  Queries only read them, so any
+ * number of threads may query a prepared graph at once, each with its
+ * own workspace.  Preparing a graph that has been prepared does nothing.
+ *
+ * @param g a pointer to a directed graph
+ * @return true if and only if the graph is now prepared
+ */
+bool ldigraph_prepare_longest(ldigraph *g);
+
+
+/**
+ * Creates a workspace for searching graphs.  It starts with room for
+ * the given number of vertices and grows when used with larger graphs.
+ * Resetting it between searches takes constant time.
+ *
+ * @param n the number of vertices to make room for
+ * @return a pointer to the new workspace, or NULL
+ */
+ldigraph_workspace *ldigraph_workspace_create(size_t n);
+
+
+/**
+ * Returns the total work done by searches in the given workspace since
+ * it was created or its counts were last reset.
+ *
+ * @param ws a pointer to a workspace, or NULL
+ * @return the counts for that workspace
+ */
+ldigraph_search_stats ldigraph_workspace_stats(const ldigraph_workspace *ws);
+
+
+/**
+ * Resets the work counts of the given workspace to zero.
+ *
+ * @param ws a pointer to a workspace, or NULL
+ */
+void ldigraph_workspace_reset_stats(ldigraph_workspace *ws);
+
+
+/**
+ * Destroys the given workspace.
+ *
+ * @param ws a pointer to a workspace, or NULL
+ */
+void ldigraph_workspace_destroy(ldigraph_workspace *ws);
+
+
 /**
  * Destroys the given directed graph.
  *
@@ -1,18 +1,178 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "ldigraph.h"
 
+#define READ_GRAPH_INITIAL_CAPACITY 1024
+
+// the least amount of text worth giving to its own parsing thread
+#define READ_GRAPH_MIN_CHUNK (1 << 20)
+
+// the time allowed for each -longest-approx query unless given
+#define DEFAULT_APPROX_MILLISECONDS 50
+
+// the number of landmarks for -engine alt
+#define ALT_LANDMARKS 16
+
+// the number of edges a generator makes from each seed it derives from
+// the given one, so that the graph is the same for any number of threads
+#define GENERATE_BLOCK (1 << 16)
+
+// the average out-degree and the layer width or component size of
+// generated graphs unless given
+#define DEFAULT_GENERATE_DEGREE 8
+#define DEFAULT_GENERATE_WIDTH 16
+
+// the chance that an R-MAT edge goes into each of the first three
+// quadrants of the adjacency matrix at each level (the fourth gets the rest)
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+typedef enum
+{
+  GENERATE_SPARSE, // the path-like acyclic graph of create_sparse
+  GENERATE_RMAT,   // R-MAT: skewed degrees and a small diameter
+  GENERATE_ER,     // Erdos-Renyi: edges between uniformly random vertices
+  GENERATE_GRID,   // a square grid with edges both ways between neighbors
+  GENERATE_DAG,    // random edges from each layer to the next two
+  GENERATE_SCC     // planted strongly connected components with random
+                   // edges from each to later ones
+} graph_generator;
+
+typedef struct
+{
+  const char *method; // the method as given on the command line
+  int (*find_path)(const ldigraph *, size_t, size_t, ldigraph_workspace *);
+  int from;           // the start vertex
+  int to;             // the end vertex
+  int length;         // the answer, once found
+  bool approximate;   // whether the answer may be a lower bound found
+                      // within a budget
+  bool exact;         // whether the answer is known to be exact
+} path_query;
+
+typedef struct
+{
+  const char *start;         // the first character to parse
+  const char *end;           // just past the last character to parse
+  long long size;            // the number of vertices in the graph
+  ldigraph_vertex *from;     // the sources of the edges found
+  ldigraph_vertex *to;       // the destinations of the edges found
+  size_t count;              // the number of edges found
+  size_t cap;                // the capacity of from and to
+  size_t integers;           // the number of integers read
+  bool stopped;              // whether parsing stopped before the end
+                             // at something that is not an integer
+  bool ok;                   // false if memory ran out
+} edge_chunk;
+
+typedef struct
+{
+  graph_generator kind; // the kind of graph
+  size_t n;             // the number of vertices
+  size_t degree;        // the average out-degree
+  size_t width;         // the vertices in each layer or component
+  uint64_t seed;        // the seed all random choices derive from
+  size_t side;          // the number of columns in a grid, or the least
+                        // power of two at least n for R-MAT (worked out
+                        // by generate_graph)
+} generator_spec;
+
+typedef struct
+{
+  const generator_spec *spec; // the graph being generated
+  ldigraph_vertex *from;      // the sources of all the edges
+  ldigraph_vertex *to;        // the destinations of all the edges
+  size_t m;                   // the number of edges
+  size_t first;               // the first block of edges to make
+  size_t step;                // the number of blocks between this one's
+} generator_task;
+
 /**
- * Reads and returns the graph contained in the given file.
- * Returns NULL if the file could not be read or if the
- * graph could not be created.
+ * Reads and returns the graph contained in the given file, which may be
+ * a text edge list or a binary graph file written by ldigraph_save.
+ * Binary files are mapped and used in place rather than parsed, and are
+ * only read through to check them if asked.  Text files are mapped too
+ * and cut into pieces at line breaks that are parsed on separate
+ * threads.  Returns NULL if the file could not be read or if the graph
+ * could not be created.
  *
  * @param fname the name of the file containing the graph
+ * @param threads the most threads to parse with, at least 1
+ * @param verify true to check every section of a binary file
+ * @param report true to report the time taken on standard error
  * @return a pointer to the graph build
  */
-ldigraph *read_graph(const char *fname);
+ldigraph *read_graph(const char *fname, int threads, bool verify, bool report);
+
+
+/**
+ * Parses the edge list text in the given buffer as the given number of
+ * pieces in parallel, and builds the graph from the edges found.  Just
+ * as a sequential reading would, pairs with a vertex out of range are
+ * skipped, and reading stops at the first thing that is not an integer.
+ *
+ * @param text the text after the number of vertices
+ * @param end just past the end of the text
+ * @param size the number of vertices in the graph
+ * @param pieces the number of pieces to parse, at least 1
+ * @param edges a pointer to a location to store the number of edges read
+ * @return a pointer to the graph build, or NULL for a memory allocation error
+ */
+ldigraph *parse_edges(const char *text, const char *end, long long size, int pieces, size_t *edges);
+
+
+/**
+ * Parses pairs of integers from the given chunk until its end or until
+ * something that is not an integer, storing the pairs that are both
+ * vertices in the chunk's arrays.
+ *
+ * @param arg a pointer to an edge_chunk, non-NULL
+ * @return NULL
+ */
+void *parse_edge_chunk(void *arg);
+
+
+/**
+ * Reads a decimal integer with an optional sign, after any white space,
+ * from the given text.  Integers too large for a long long are read as
+ * the largest long long of the same sign.
+ *
+ * @param pos a pointer to the position to start at, which is advanced
+ * past the integer if there is one, and past any white space otherwise
+ * @param end just past the end of the text
+ * @param value a pointer to a location to store the integer
+ * @return true if and only if there was an integer
+ */
+bool parse_integer(const char **pos, const char *end, long long *value);
+
+
+/**
+ * Doubles the capacity of the parallel edge endpoint arrays used while
+ * reading a graph.  The arrays are left as they were if there is not
+ * enough memory.
+ *
+ * @param from_list a pointer to the array of source vertices
+ * @param to_list a pointer to the array of destination vertices
+ * @param cap a pointer to the current capacity of both arrays
+ * @return true if and only if the arrays were resized
+ */
+bool embiggen_edge_list(ldigraph_vertex **from_list, ldigraph_vertex **to_list, size_t *cap);
 
 
 /**
@@ -28,41 +188,386 @@ ldigraph *read_graph(const char *fname);
 ldigraph *create_sparse(size_t size);
 
 
+/**
+ * Creates a random graph of the given kind.  The edges are made on
+ * separate threads in blocks, each block from its own seed derived from
+ * the given one, so the graph depends only on the specification.  Edges
+ * that would be loops or that were made already are left out.
+ *
+ * @param spec a pointer to the specification of the graph, non-NULL,
+ * whose side is filled in
+ * @param threads the most threads to generate with, at least 1
+ * @return a pointer to a graph, or NULL for a memory allocation error
+ */
+ldigraph *generate_graph(generator_spec *spec, int threads);
+
+
+/**
+ * Makes the blocks of edges given by the given task.
+ *
+ * @param arg a pointer to a generator_task, non-NULL
+ * @return NULL
+ */
+void *generate_edges(void *arg);
+
+
+/**
+ * Makes one edge of the given graph.
+ *
+ * @param spec a pointer to the specification of the graph, non-NULL
+ * @param e the index of the edge
+ * @param state a pointer to the random state of the edge's block
+ * @param from a pointer to a location to store the source
+ * @param to a pointer to a location to store the destination, which is
+ * the same as the source if the edge is to be left out
+ */
+void generate_edge(const generator_spec *spec, size_t e, uint64_t *state, ldigraph_vertex *from, ldigraph_vertex *to);
+
+
+/**
+ * Advances the given random state and returns the next random number
+ * (SplitMix64).
+ *
+ * @param state a pointer to the state, non-NULL
+ * @return a random 64-bit number
+ */
+uint64_t next_random(uint64_t *state);
+
+
+/**
+ * Reads the given option value as a non-negative decimal integer.  The
+ * whole string must be digits, so that a sign, trailing characters, or
+ * a value too large for an unsigned long long are rejected rather than
+ * read as some other number.
+ *
+ * @param s a string, or NULL if the option had no value
+ * @param value a pointer to a location to store the integer
+ * @return true if and only if s is a non-negative integer
+ */
+bool parse_option_integer(const char *s, unsigned long long *value);
+
+
+/**
+ * Reads the given option value as a non-negative decimal number, such
+ * as 2, 0.5, or 1e3.  The whole string must be the number, and values
+ * too large for a double are rejected.
+ *
+ * @param s a string, or NULL if the option had no value
+ * @param value a pointer to a location to store the number
+ * @return true if and only if s is a non-negative number
+ */
+bool parse_option_number(const char *s, double *value);
+
+
+/**
+ * Determines the graph generator named by the given string, which may be
+ * "sparse", "rmat", "er", "grid", "dag", or "scc".
+ *
+ * @param s a string, non-NULL
+ * @param kind a pointer to a location to store the generator
+ * @return true if and only if s names a generator
+ */
+bool determine_generator(const char *s, graph_generator *kind);
+
+
 /**
  * Returns a pointer to the graph path finding function specified by the
  * given string.  The string may be "-shortest" or "-longest"
  * to specify finding the shortest or longest path respectively.
+ * "-longest-approx" also gives the longest path function; those queries
+ * are answered within a budget instead.
+ * The functions take a workspace to reuse between queries.
  *
  * @param s a string, non-NULL
  * @return a pointer to the corresponding function
  */
-int (*determine_method(const char *s))(const ldigraph*, size_t, size_t);
+int (*determine_method(const char *s))(const ldigraph*, size_t, size_t, ldigraph_workspace *);
+
+
+/**
+ * Parses the given command-line arguments as method/from/to triples,
+ * storing the ones with a known method and legal vertices in the given
+ * array.  Other triples are skipped.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param args an array of arguments
+ * @param count the number of arguments
+ * @param queries an array with room for count / 3 queries
+ * @return the number of queries stored
+ */
+size_t parse_queries(const ldigraph *g, char **args, int count, path_query *queries);
+
+
+/**
+ * Finds the answers to the given queries.  Queries are grouped by method
+ * and start vertex.  Shortest path queries from a common start vertex
+ * are answered with one search, or, when the graph uses the default
+ * shortest path engine and there are several start vertices, as a batch
+ * so that queries from different start vertices share traversals too.
+ * Other queries are answered once for each distinct pair of vertices.
+ * In timing mode the work done is reported on standard error.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param queries an array of queries
+ * @param count the number of queries
+ * @param ws a pointer to a workspace, non-NULL
+ * @param budget a pointer to the budget for approximate queries, non-NULL
+ * @param timing true to report the work done
+ */
+void answer_queries(const ldigraph *g, path_query *queries, size_t count, ldigraph_workspace *ws, const ldigraph_longest_budget *budget, bool timing);
+
+
+/**
+ * Answers the given query if it has not been answered already.  In
+ * timing mode the work done is reported on standard error.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param query a pointer to a query, non-NULL
+ * @param ws a pointer to a workspace, non-NULL
+ * @param budget a pointer to the budget for approximate queries, non-NULL
+ * @param timing true to report the work done
+ */
+void answer_query(const ldigraph *g, path_query *query, ldigraph_workspace *ws, const ldigraph_longest_budget *budget, bool timing);
+
+
+/**
+ * Compares two pointers to queries by method, then start vertex, then
+ * end vertex.
+ *
+ * @param a a pointer to a pointer to a query, non-NULL
+ * @param b a pointer to a pointer to a query, non-NULL
+ * @return a negative number, zero, or a positive number as the first
+ * query is before, the same as, or after the second
+ */
+int path_query_compare(const void *a, const void *b);
+
+
+/**
+ * Gives the given graph a 2-hop labeling for answering shortest path
+ * queries.  The labeling is loaded from the graph's file name with
+ * ".labels" added if that file has one that fits the graph; otherwise
+ * it is built and saved there.  In timing mode the time taken is
+ * reported on standard error.
+ *
+ * @param g a pointer to a directed graph, non-NULL
+ * @param fname the name of the file the graph was read from, or NULL
+ * if there is none
+ * @param timing true to report the time taken
+ */
+void prepare_labels(ldigraph *g, const char *fname, bool timing);
+
+
+/**
+ * Determines the shortest path engine named by the given string, which
+ * may be "auto", "bfs", "bidirectional", "direction" (for
+ * direction-optimizing BFS), or "alt" (for A* search with landmarks).
+ *
+ * @param s a string, non-NULL
+ * @param engine a pointer to a location to store the engine
+ * @return true if and only if s names an engine
+ */
+bool determine_engine(const char *s, ldigraph_shortest_engine *engine);
+
+
+/**
+ * Determines the vertex reordering strategy named by the given string,
+ * which may be "bfs", "rcm" (for reverse Cuthill-McKee), "degree", or
+ * "gorder".
+ *
+ * @param s a string, non-NULL
+ * @param strategy a pointer to a location to store the strategy
+ * @return true if and only if s names a strategy
+ */
+bool determine_reorder(const char *s, ldigraph_reorder_strategy *strategy);
+
+
+/**
+ * Replaces the vertices of the given queries with their numbers in the
+ * given array.
+ *
+ * @param queries an array of queries
+ * @param count the number of queries
+ * @param numbers the new number of each vertex, non-NULL
+ */
+void renumber_queries(path_query *queries, size_t count, const ldigraph_vertex *numbers);
 
 
 int main(int argc, char **argv)
 {
+  // options come before the graph and apply to all queries
+  ldigraph_shortest_engine engine = LDIGRAPH_SHORTEST_AUTO;
+  int threads = 1;
+  ldigraph_longest_budget budget = {DEFAULT_APPROX_MILLISECONDS / 1000.0, 0};
+  bool labels = false;
+  bool verbose = false;
+  bool compress = false;
+  bool verify = false;
+  bool reorder = false;
+  ldigraph_reorder_strategy strategy = LDIGRAPH_REORDER_BFS;
+  generator_spec spec = {GENERATE_SPARSE, 0, DEFAULT_GENERATE_DEGREE, DEFAULT_GENERATE_WIDTH, 1, 0};
+  int opt = 1;
+  while (opt < argc && (strcmp(argv[opt], "-engine") == 0 || strcmp(argv[opt], "-threads") == 0
+			|| strcmp(argv[opt], "-budget") == 0 || strcmp(argv[opt], "-expansions") == 0
+			|| strcmp(argv[opt], "-labels") == 0 || strcmp(argv[opt], "-verbose") == 0
+			|| strcmp(argv[opt], "-compress") == 0 || strcmp(argv[opt], "-verify") == 0
+			|| strcmp(argv[opt], "-reorder") == 0
+			|| strcmp(argv[opt], "-generate") == 0 || strcmp(argv[opt], "-seed") == 0
+			|| strcmp(argv[opt], "-degree") == 0 || strcmp(argv[opt], "-width") == 0))
+    {
+      if (strcmp(argv[opt], "-labels") == 0 || strcmp(argv[opt], "-verbose") == 0
+	  || strcmp(argv[opt], "-compress") == 0 || strcmp(argv[opt], "-verify") == 0)
+	{
+	  // the only options without a value
+	  labels = labels || strcmp(argv[opt], "-labels") == 0;
+	  verbose = verbose || strcmp(argv[opt], "-verbose") == 0;
+	  compress = compress || strcmp(argv[opt], "-compress") == 0;
+	  verify = verify || strcmp(argv[opt], "-verify") == 0;
+	  opt++;
+	  continue;
+	}
+      if (strcmp(argv[opt], "-engine") == 0
+	  && (opt + 1 >= argc || !determine_engine(argv[opt + 1], &engine)))
+	{
+	  fprintf(stderr, "%s: engine must be auto, bfs, bidirectional, direction, or alt\n", argv[0]);
+	  return 1;
+	}
+      else if (strcmp(argv[opt], "-reorder") == 0
+	       && (opt + 1 >= argc || !(reorder = determine_reorder(argv[opt + 1], &strategy))))
+	{
+	  fprintf(stderr, "%s: reorder must be bfs, rcm, degree, or gorder\n", argv[0]);
+	  return 1;
+	}
+      else if (strcmp(argv[opt], "-generate") == 0
+	       && (opt + 1 >= argc || !determine_generator(argv[opt + 1], &spec.kind)))
+	{
+	  fprintf(stderr, "%s: generator must be sparse, rmat, er, grid, dag, or scc\n", argv[0]);
+	  return 1;
+	}
+      else if (strcmp(argv[opt], "-seed") == 0)
+	{
+	  unsigned long long seed;
+	  if (!parse_option_integer(opt + 1 < argc ? argv[opt + 1] : NULL, &seed))
+	    {
+	      fprintf(stderr, "%s: seed must be a non-negative integer\n", argv[0]);
+	      return 1;
+	    }
+	  spec.seed = seed;
+	}
+      else if (strcmp(argv[opt], "-degree") == 0 || strcmp(argv[opt], "-width") == 0)
+	{
+	  unsigned long long value;
+	  if (!parse_option_integer(opt + 1 < argc ? argv[opt + 1] : NULL, &value)
+	      || value < 1 || value > SIZE_MAX)
+	    {
+	      fprintf(stderr, "%s: %s must be a positive integer\n", argv[0], argv[opt] + 1);
+	      return 1;
+	    }
+	  if (strcmp(argv[opt], "-degree") == 0)
+	    {
+	      spec.degree = value;
+	    }
+	  else
+	    {
+	      spec.width = value;
+	    }
+	}
+      else if (strcmp(argv[opt], "-threads") == 0
+	       && (opt + 1 >= argc || (threads = atoi(argv[opt + 1])) < 1))
+	{
+	  fprintf(stderr, "%s: threads must be a positive integer\n", argv[0]);
+	  return 1;
+	}
+      else if (strcmp(argv[opt], "-budget") == 0)
+	{
+	  // atof would take "abc" as 0, which means no limit at all
+	  double milliseconds;
+	  if (!parse_option_number(opt + 1 < argc ? argv[opt + 1] : NULL, &milliseconds))
+	    {
+	      fprintf(stderr, "%s: budget must be a number of milliseconds\n", argv[0]);
+	      return 1;
+	    }
+	  budget.seconds = milliseconds / 1000;
+	}
+      else if (strcmp(argv[opt], "-expansions") == 0)
+	{
+	  unsigned long long expansions;
+	  if (!parse_option_integer(opt + 1 < argc ? argv[opt + 1] : NULL, &expansions)
+	      || expansions > SIZE_MAX)
+	    {
+	      fprintf(stderr, "%s: expansions must be a non-negative integer\n", argv[0]);
+	      return 1;
+	    }
+	  budget.expansions = expansions;
+	}
+      opt += 2;
+    }
+
+  // drop the options so the graph is in argv[1] as before
+  argv[opt - 1] = argv[0];
+  argv += opt - 1;
+  argc -= opt - 1;
+  
   if (argc < 2)
     {
-      fprintf(stderr, "USAGE: %s filename [[method from to...]...]\n", argv[0]);
+      fprintf(stderr, "USAGE: %s [-engine name] [-threads n] [-budget ms] [-expansions n] [-reorder name] [-labels] [-compress] [-verify] [-verbose] [-generate name] [-seed n] [-degree d] [-width w] filename [[method from to...]...]\n", argv[0]);
       return 1;
     }
 
+  if (strcmp(argv[1], "-convert") == 0)
+    {
+      if (argc != 4)
+	{
+	  fprintf(stderr, "USAGE: %s -convert input output\n", argv[0]);
+	  return 1;
+	}
+
+      // save in-edges and the reachability index too so that loading
+      // the output needs no setup; converting reads the whole input
+      // anyway, so a binary one is always checked
+      ldigraph *g = read_graph(argv[2], threads, true, true);
+      bool ok = (g != NULL && ldigraph_build_in_edges(g) && ldigraph_build_reachability(g)
+		 && ldigraph_save(g, argv[3]));
+      if (!ok)
+	{
+	  fprintf(stderr, "%s: could not convert %s to %s\n", argv[0], argv[2], argv[3]);
+	}
+      ldigraph_destroy(g);
+      return ok ? 0 : 1;
+    }
+  
   ldigraph *g;
-  if (strcmp(argv[1], "-timing") == 0)
+  bool timing = strcmp(argv[1], "-timing") == 0;
+  if (timing)
     {
-      int size;
-      if (argc < 4 || (size = atoi(argv[argc - 2])) <= 0)
+      long long size;
+      if (argc < 4 || (size = atoll(argv[argc - 2])) <= 0)
 	{
 	  fprintf(stderr, "USAGE: %s -timing [[method from to...]...] size on/off\n", argv[0]);
 	  return 1;
 	}
       int on = atoi(argv[argc - 1]);
 
-      g = create_sparse(size);
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      spec.n = size;
+      size_t per_vertex = spec.kind == GENERATE_GRID ? 4 : spec.degree;
+      // the size of the edge arrays must not overflow
+      if (spec.kind != GENERATE_SPARSE && spec.n > SIZE_MAX / sizeof(ldigraph_vertex) / per_vertex)
+	{
+	  fprintf(stderr, "%s: %lld vertices with %zu edges each is too many\n", argv[0], size, per_vertex);
+	  return 1;
+	}
+      g = generate_graph(&spec, threads);
+      clock_gettime(CLOCK_MONOTONIC, &end);
       if (g == NULL)
 	{
 	  return 1;
 	}
+      if (verbose)
+	{
+	  fprintf(stderr, "generated %zu vertices in %.3f s with %d threads\n", spec.n,
+		  (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9, threads);
+	}
       
       if (on != 1)
 	{
@@ -77,38 +582,92 @@ int main(int argc, char **argv)
   else
     {
       // read graph from file
-      g = read_graph(argv[1]);
+      g = read_graph(argv[1], threads, verify, verbose);
     }
 
-  if (g != NULL)
+  // the new number of each vertex and the old number of each, if the
+  // graph is renumbered
+  ldigraph_vertex *forward = NULL;
+  ldigraph_vertex *inverse = NULL;
+  if (g != NULL && reorder)
     {
-      size_t a = 2;
-      while (a + 2 < argc)
+      // queries are renumbered to match, so answers are unaffected; if
+      // there is not enough memory the graph is used as it is
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      ldigraph *renumbered = ldigraph_reorder(g, strategy, &forward, &inverse);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      if (renumbered != NULL)
 	{
-	  // determine search method
-	  int (*find_path)(const ldigraph *, size_t, size_t) = determine_method(argv[a]);
+	  ldigraph_destroy(g);
+	  g = renumbered;
+	  if (verbose || timing)
+	    {
+	      fprintf(stderr, "vertices reordered in %.3f s\n",
+		      (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+	    }
+	}
+    }
 
-	  if (find_path != NULL)
+  if (g != NULL)
+    {
+      // the graph is only read from here on, so pack it and add in-edges,
+      // a reachability index, and what longest path queries use
+      ldigraph_build_in_edges(g);
+      ldigraph_build_reachability(g);
+      ldigraph_prepare_longest(g);
+      if (compress)
+	{
+	  // only lengths are reported, so the order of neighbors does not
+	  // matter and sorted lists compress better
+	  size_t before = ldigraph_edge_bytes(g);
+	  if (ldigraph_compress(g, true) && verbose)
 	    {
-	      // get from vertex
-	      int from = atoi(argv[a + 1]);
-	      int to = atoi(argv[a + 2]);
+	      fprintf(stderr, "edge lists compressed from %zu to %zu bytes\n", before, ldigraph_edge_bytes(g));
+	    }
+	}
+      ldigraph_set_shortest_engine(g, engine);
+      ldigraph_set_threads(g, threads);
+      if (engine == LDIGRAPH_SHORTEST_ALT)
+	{
+	  ldigraph_build_landmarks(g, ALT_LANDMARKS);
+	}
+      if (labels)
+	{
+	  prepare_labels(g, timing ? NULL : argv[1], timing);
+	}
 
-	      // check whether vertices are legal
-	      if (from >= 0 && from < ldigraph_size(g) && to >= 0 && to < ldigraph_size(g))
-		{
-		  // do the search 
-		  int length = find_path(g, from, to);
+      // one workspace serves all the queries
+      ldigraph_workspace *ws = ldigraph_workspace_create(ldigraph_size(g));
+      
+      // collect all the queries first so that ones that can share a
+      // traversal do
+      path_query *queries = malloc(sizeof(path_query) * (argc / 3 + 1));
+      if (ws != NULL && queries != NULL)
+	{
+	  size_t count = parse_queries(g, argv + 2, argc - 2, queries);
+	  if (forward != NULL)
+	    {
+	      renumber_queries(queries, count, forward);
+	    }
+	  answer_queries(g, queries, count, ws, &budget, timing);
+	  if (inverse != NULL)
+	    {
+	      renumber_queries(queries, count, inverse);
+	    }
 
-		  // print answer
-		  printf("%9.9s: %3d ~> %3d: %d\n", argv[a], from, to, length);
-		}
+	  // print answers in the order the queries were given
+	  for (size_t i = 0; i < count; i++)
+	    {
+	      printf("%9s: %3d ~> %3d: %d%s\n", queries[i].method, queries[i].from, queries[i].to, queries[i].length,
+		     queries[i].exact ? "" : " (lower bound)");
 	    }
-	  
-	  // go on to next method
-	  a += 3;
 	}
       
+      free(queries);
+      free(forward);
+      free(inverse);
+      ldigraph_workspace_destroy(ws);
       ldigraph_destroy(g);
     }
 
@@ -116,67 +675,764 @@ int main(int argc, char **argv)
 }
 
 
-ldigraph *read_graph(const char *fname)
+ldigraph *read_graph(const char *fname, int threads, bool verify, bool report)
 {
-  FILE *in = fopen(fname, "r");
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  
+  int fd = open(fname, O_RDONLY);
+  struct stat info;
+  if (fd == -1 || fstat(fd, &info) == -1 || info.st_size == 0)
+    {
+      if (fd != -1)
+	{
+	  close(fd);
+	}
+      return NULL;
+    }
+  size_t length = info.st_size;
+  const char *text = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (text == MAP_FAILED)
+    {
+      return NULL;
+    }
+  
+  // binary files start with a magic string that no edge list does
   ldigraph *g = NULL;
-
-  if (in != NULL)
+  size_t edges = 0;
+  int pieces = 0;
+  size_t magic = sizeof(LDIGRAPH_FILE_MAGIC) - 1;
+  if (length >= magic && memcmp(text, LDIGRAPH_FILE_MAGIC, magic) == 0)
+    {
+      munmap((void *)text, length);
+      g = verify ? ldigraph_map_checked(fname) : ldigraph_map(fname);
+    }
+  else
     {
-      size_t size;
-      if (fscanf(in, "%zu", &size) == 1)
+      posix_madvise((void *)text, length, POSIX_MADV_SEQUENTIAL);
+      const char *pos = text;
+      long long size;
+      if (parse_integer(&pos, text + length, &size) && size >= 0)
 	{
-	  g = ldigraph_create(size);
-
-	  if (g != NULL)
+	  // small files are not worth the threads
+	  pieces = threads;
+	  if ((text + length - pos) / READ_GRAPH_MIN_CHUNK < pieces)
 	    {
-	      int from, to;
-	      while (fscanf(in, "%d %d", &from, &to) == 2)
-		{
-		  if (from >= 0 && from < size && to >= 0 && to < size)
-		    {
-		      ldigraph_add_edge(g, from, to);
-		    }
-		}
+	      pieces = (text + length - pos) / READ_GRAPH_MIN_CHUNK + 1;
 	    }
+	  g = parse_edges(pos, text + length, size, pieces, &edges);
 	}
-      
-      fclose(in);
+      munmap((void *)text, length);
     }
+  clock_gettime(CLOCK_MONOTONIC, &end);
 
+  if (report && g != NULL)
+    {
+      double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+      if (pieces == 0)
+	{
+	  fprintf(stderr, "%s: mapped in %.3f s\n", fname, seconds);
+	}
+      else
+	{
+	  fprintf(stderr, "%s: %zu bytes, %zu edges read in %.3f s (%.1f MB/s) with %d threads\n",
+		  fname, length, edges, seconds, length / 1e6 / (seconds > 0 ? seconds : 1e-9), pieces);
+	}
+    }
+  
   return g;
 }
 
-int (*determine_method(const char *s))(const ldigraph*, size_t, size_t)
+
+ldigraph *parse_edges(const char *text, const char *end, long long size, int pieces, size_t *edges)
 {
-  if (strcmp(s, "-shortest") == 0)
+  edge_chunk *chunks = malloc(sizeof(edge_chunk) * pieces);
+  pthread_t *ids = malloc(sizeof(pthread_t) * pieces);
+  bool *started = malloc(sizeof(bool) * pieces);
+  if (chunks == NULL || ids == NULL || started == NULL)
     {
-      return ldigraph_shortest_path;
+      free(chunks);
+      free(ids);
+      free(started);
+      return NULL;
     }
-  else if (strcmp(s, "-longest") == 0)
+
+  // cut just after line breaks so that no integer is split between pieces
+  const char *cut = text;
+  for (int i = 0; i < pieces; i++)
     {
-      return ldigraph_longest_path;
+      chunks[i].start = cut;
+      if (i < pieces - 1)
+	{
+	  const char *middle = text + (end - text) / pieces * (i + 1);
+	  cut = memchr(middle > cut ? middle : cut, '\n', end - (middle > cut ? middle : cut));
+	  cut = cut != NULL ? cut + 1 : end;
+	}
+      else
+	{
+	  cut = end;
+	}
+      chunks[i].end = cut;
+      chunks[i].size = size;
+      chunks[i].count = 0;
+      chunks[i].cap = READ_GRAPH_INITIAL_CAPACITY;
+      chunks[i].integers = 0;
     }
-  else
+
+  // the calling thread takes the first piece, and any piece that could
+  // not get a thread of its own
+  for (int i = 1; i < pieces; i++)
     {
-      return NULL;
+      started[i] = pthread_create(&ids[i], NULL, parse_edge_chunk, &chunks[i]) == 0;
+    }
+  parse_edge_chunk(&chunks[0]);
+  for (int i = 1; i < pieces; i++)
+    {
+      if (started[i])
+	{
+	  pthread_join(ids[i], NULL);
+	}
+      else
+	{
+	  parse_edge_chunk(&chunks[i]);
+	}
     }
-}
 
-ldigraph *create_sparse(size_t size)
-{
-  // make a sparse graph for timing -shortest and -longest on acyclic
-  ldigraph *g = ldigraph_create(size);
-  
-  if (g == NULL)
+  // pieces after one that stopped early are not part of the graph; a
+  // piece with an odd number of integers before that pairs the rest
+  // differently, so then the whole text is parsed again in one piece
+  int used = 0;
+  bool ok = true;
+  bool aligned = true;
+  while (used < pieces)
     {
-      return NULL;
+      ok = ok && chunks[used].ok;
+      used++;
+      if (chunks[used - 1].stopped)
+	{
+	  break;
+	}
+      else if (used < pieces && chunks[used - 1].integers % 2 != 0)
+	{
+	  aligned = false;
+	}
     }
-  
-  // main spine of the graph will be 0->2->3->...->size-1->1
-  // with additional edges from the vertices between 2 and size-2
-  
-  // vertex 0 will be the source vertex (1st in topo sort)
+  if (ok && !aligned)
+    {
+      for (int i = 0; i < pieces; i++)
+	{
+	  free(chunks[i].from);
+	  free(chunks[i].to);
+	}
+      chunks[0].end = end;
+      chunks[0].count = 0;
+      chunks[0].cap = READ_GRAPH_INITIAL_CAPACITY;
+      parse_edge_chunk(&chunks[0]);
+      ok = chunks[0].ok;
+      used = 1;
+      pieces = 1;
+    }
+
+  // gather the edges from all the pieces so the graph can be built in one go
+  ldigraph *g = NULL;
+  size_t count = 0;
+  for (int i = 0; i < used; i++)
+    {
+      count += chunks[i].count;
+    }
+  if (ok && used == 1)
+    {
+      g = ldigraph_create_from_edges(size, chunks[0].from, chunks[0].to, count);
+    }
+  else if (ok)
+    {
+      ldigraph_vertex *from_list = malloc(sizeof(ldigraph_vertex) * (count > 0 ? count : 1));
+      ldigraph_vertex *to_list = malloc(sizeof(ldigraph_vertex) * (count > 0 ? count : 1));
+      if (from_list != NULL && to_list != NULL)
+	{
+	  size_t copied = 0;
+	  for (int i = 0; i < used; i++)
+	    {
+	      memcpy(from_list + copied, chunks[i].from, sizeof(ldigraph_vertex) * chunks[i].count);
+	      memcpy(to_list + copied, chunks[i].to, sizeof(ldigraph_vertex) * chunks[i].count);
+	      copied += chunks[i].count;
+	    }
+	  g = ldigraph_create_from_edges(size, from_list, to_list, count);
+	}
+      free(from_list);
+      free(to_list);
+    }
+  *edges = count;
+
+  for (int i = 0; i < pieces; i++)
+    {
+      free(chunks[i].from);
+      free(chunks[i].to);
+    }
+  free(chunks);
+  free(ids);
+  free(started);
+  
+  return g;
+}
+
+
+void *parse_edge_chunk(void *arg)
+{
+  edge_chunk *chunk = arg;
+  chunk->from = malloc(sizeof(ldigraph_vertex) * chunk->cap);
+  chunk->to = malloc(sizeof(ldigraph_vertex) * chunk->cap);
+  chunk->ok = chunk->from != NULL && chunk->to != NULL;
+
+  const char *pos = chunk->start;
+  long long from, to;
+  while (chunk->ok && parse_integer(&pos, chunk->end, &from))
+    {
+      chunk->integers++;
+      if (!parse_integer(&pos, chunk->end, &to))
+	{
+	  break;
+	}
+      chunk->integers++;
+      
+      if (from >= 0 && from < chunk->size && to >= 0 && to < chunk->size)
+	{
+	  if (chunk->count == chunk->cap)
+	    {
+	      chunk->ok = embiggen_edge_list(&chunk->from, &chunk->to, &chunk->cap);
+	    }
+
+	  if (chunk->ok)
+	    {
+	      chunk->from[chunk->count] = from;
+	      chunk->to[chunk->count] = to;
+	      chunk->count++;
+	    }
+	}
+    }
+  chunk->stopped = pos < chunk->end;
+
+  return NULL;
+}
+
+
+bool parse_integer(const char **pos, const char *end, long long *value)
+{
+  const char *p = *pos;
+  while (p < end && isspace((unsigned char)*p))
+    {
+      p++;
+    }
+  *pos = p;
+
+  bool negative = p < end && *p == '-';
+  if (p < end && (*p == '-' || *p == '+'))
+    {
+      p++;
+    }
+  if (p == end || !isdigit((unsigned char)*p))
+    {
+      return false;
+    }
+
+  long long magnitude = 0;
+  while (p < end && isdigit((unsigned char)*p))
+    {
+      int digit = *p - '0';
+      magnitude = magnitude > (LLONG_MAX - digit) / 10 ? LLONG_MAX : magnitude * 10 + digit;
+      p++;
+    }
+  
+  *value = negative ? -magnitude : magnitude;
+  *pos = p;
+  return true;
+}
+
+
+bool embiggen_edge_list(ldigraph_vertex **from_list, ldigraph_vertex **to_list, size_t *cap)
+{
+  ldigraph_vertex *bigger_from = realloc(*from_list, sizeof(ldigraph_vertex) * *cap * 2);
+  if (bigger_from == NULL)
+    {
+      return false;
+    }
+  *from_list = bigger_from;
+
+  ldigraph_vertex *bigger_to = realloc(*to_list, sizeof(ldigraph_vertex) * *cap * 2);
+  if (bigger_to == NULL)
+    {
+      return false;
+    }
+  *to_list = bigger_to;
+
+  *cap *= 2;
+  return true;
+}
+
+int (*determine_method(const char *s))(const ldigraph*, size_t, size_t, ldigraph_workspace *)
+{
+  if (strcmp(s, "-shortest") == 0)
+    {
+      return ldigraph_shortest_path_with;
+    }
+  else if (strcmp(s, "-longest") == 0 || strcmp(s, "-longest-approx") == 0)
+    {
+      return ldigraph_longest_path_with;
+    }
+  else
+    {
+      return NULL;
+    }
+}
+
+size_t parse_queries(const ldigraph *g, char **args, int count, path_query *queries)
+{
+  size_t query_count = 0;
+  int a = 0;
+  while (a + 2 < count)
+    {
+      // determine search method
+      int (*find_path)(const ldigraph *, size_t, size_t, ldigraph_workspace *) = determine_method(args[a]);
+
+      if (find_path != NULL)
+	{
+	  // get from vertex
+	  int from = atoi(args[a + 1]);
+	  int to = atoi(args[a + 2]);
+
+	  // check whether vertices are legal
+	  if (from >= 0 && from < ldigraph_size(g) && to >= 0 && to < ldigraph_size(g))
+	    {
+	      queries[query_count].method = args[a];
+	      queries[query_count].find_path = find_path;
+	      queries[query_count].from = from;
+	      queries[query_count].to = to;
+	      queries[query_count].length = -1;
+	      queries[query_count].approximate = strcmp(args[a], "-longest-approx") == 0;
+	      queries[query_count].exact = true;
+	      query_count++;
+	    }
+	}
+	  
+      // go on to next method
+      a += 3;
+    }
+
+  return query_count;
+}
+
+
+void answer_queries(const ldigraph *g, path_query *queries, size_t count, ldigraph_workspace *ws, const ldigraph_longest_budget *budget, bool timing)
+{
+  // put queries with the same method and start vertex next to each other
+  size_t cap = count > 0 ? count : 1;
+  path_query **order = malloc(sizeof(path_query *) * cap);
+  size_t *targets = malloc(sizeof(size_t) * cap);
+  int *lengths = malloc(sizeof(int) * cap);
+  if (order == NULL || targets == NULL || lengths == NULL)
+    {
+      free(order);
+      free(targets);
+      free(lengths);
+      order = NULL;
+      targets = NULL;
+      lengths = NULL;
+    }
+  else
+    {
+      for (size_t i = 0; i < count; i++)
+	{
+	  order[i] = &queries[i];
+	}
+      qsort(order, count, sizeof(path_query *), path_query_compare);
+    }
+
+  // with the default engine, shortest path queries from several start
+  // vertices are better left to the batch, which shares sweeps between
+  // start vertices as well as targets
+  size_t shortest_sources = 0;
+  for (size_t i = 0; order != NULL && i < count; i++)
+    {
+      if (order[i]->find_path == ldigraph_shortest_path_with
+	  && (i == 0 || order[i - 1]->find_path != ldigraph_shortest_path_with || order[i - 1]->from != order[i]->from))
+	{
+	  shortest_sources++;
+	}
+    }
+  bool batch_sources = shortest_sources > 1 && ldigraph_get_shortest_engine(g) == LDIGRAPH_SHORTEST_AUTO;
+      
+  // answer each group with one search
+  int *dist = NULL;
+  size_t start = 0;
+  while (order != NULL && start < count)
+    {
+      size_t end = start + 1;
+      while (end < count && strcmp(order[end]->method, order[start]->method) == 0
+	     && order[end]->from == order[start]->from)
+	{
+	  end++;
+	}
+
+      if (order[start]->find_path == ldigraph_shortest_path_with)
+	{
+	  if (!batch_sources && end - start > 1)
+	    {
+	      // one search for all targets; with more than one thread use
+	      // the parallel search for every distance instead, unless the
+	      // labels can answer without searching
+	      bool found = false;
+	      bool parallel = ldigraph_get_threads(g) > 1 && ldigraph_label_count(g) == 0;
+	      ldigraph_workspace_reset_stats(ws);
+	      if (parallel)
+		{
+		  if (dist == NULL)
+		    {
+		      dist = malloc(sizeof(int) * ldigraph_size(g));
+		    }
+		  if (dist != NULL && ldigraph_distances_from(g, order[start]->from, dist))
+		    {
+		      for (size_t i = start; i < end; i++)
+			{
+			  lengths[i - start] = dist[order[i]->to];
+			}
+		      found = true;
+		    }
+		}
+	      else
+		{
+		  for (size_t i = start; i < end; i++)
+		    {
+		      targets[i - start] = order[i]->to;
+		    }
+		  found = ldigraph_shortest_paths_from(g, order[start]->from, targets, end - start, lengths, ws);
+		}
+
+	      if (found)
+		{
+		  for (size_t i = start; i < end; i++)
+		    {
+		      order[i]->length = lengths[i - start];
+		      order[i]->find_path = NULL;
+		    }
+		  
+		  if (timing && parallel)
+		    {
+		      // the parallel search does not count its work
+		      fprintf(stderr, "%9s: %3d ~> %zu targets: searched with %zu threads\n",
+			      order[start]->method, order[start]->from, end - start, ldigraph_get_threads(g));
+		    }
+		  else if (timing)
+		    {
+		      ldigraph_search_stats stats = ldigraph_workspace_stats(ws);
+		      fprintf(stderr, "%9s: %3d ~> %zu targets: scanned %zu vertices, %zu edges\n",
+			      order[start]->method, order[start]->from, end - start, stats.vertices, stats.edges);
+		    }
+		}
+	    }
+	}
+      else
+	{
+	  // ask each distinct query once and copy the answer to repeats
+	  for (size_t i = start + 1; i < end; i++)
+	    {
+	      if (order[i]->to == order[i - 1]->to)
+		{
+		  answer_query(g, order[i - 1], ws, budget, timing);
+		  order[i]->length = order[i - 1]->length;
+		  order[i]->exact = order[i - 1]->exact;
+		  order[i]->find_path = NULL;
+		}
+	    }
+	}
+      
+      start = end;
+    }
+  free(dist);
+  
+  // gather the remaining shortest path queries if they are to be batched
+  size_t batch_count = 0;
+  size_t *batch = malloc(sizeof(size_t) * cap);
+  size_t *from = malloc(sizeof(size_t) * cap);
+  size_t *to = malloc(sizeof(size_t) * cap);
+  if (batch != NULL && from != NULL && to != NULL && lengths != NULL
+      && ldigraph_get_shortest_engine(g) == LDIGRAPH_SHORTEST_AUTO)
+    {
+      for (size_t i = 0; i < count; i++)
+	{
+	  if (queries[i].find_path == ldigraph_shortest_path_with)
+	    {
+	      batch[batch_count] = i;
+	      from[batch_count] = queries[i].from;
+	      to[batch_count] = queries[i].to;
+	      batch_count++;
+	    }
+	}
+    }
+
+  // a single query has nothing to share with
+  ldigraph_workspace_reset_stats(ws);
+  if (batch_count > 1 && ldigraph_shortest_paths_batch(g, from, to, batch_count, lengths, ws))
+    {
+      for (size_t i = 0; i < batch_count; i++)
+	{
+	  queries[batch[i]].length = lengths[i];
+	  queries[batch[i]].find_path = NULL;
+	}
+
+      if (timing)
+	{
+	  ldigraph_search_stats stats = ldigraph_workspace_stats(ws);
+	  fprintf(stderr, "%zu -shortest queries: scanned %zu vertices, %zu edges\n",
+		  batch_count, stats.vertices, stats.edges);
+	}
+    }
+  
+  for (size_t i = 0; i < count; i++)
+    {
+      answer_query(g, &queries[i], ws, budget, timing);
+    }
+
+  free(order);
+  free(targets);
+  free(lengths);
+  free(batch);
+  free(from);
+  free(to);
+}
+
+
+void answer_query(const ldigraph *g, path_query *query, ldigraph_workspace *ws, const ldigraph_longest_budget *budget, bool timing)
+{
+  if (query->find_path != NULL)
+    {
+      // do the search 
+      struct timespec start, end;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      ldigraph_workspace_reset_stats(ws);
+      if (query->approximate)
+	{
+	  query->length = ldigraph_longest_path_budgeted_with(g, query->from, query->to, *budget, &query->exact, ws);
+	}
+      else
+	{
+	  query->length = query->find_path(g, query->from, query->to, ws);
+	}
+      query->find_path = NULL;
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      
+      if (timing)
+	{
+	  // report how much of the graph the search had to look at and how
+	  // long it took, so that thread counts can be compared
+	  ldigraph_search_stats stats = ldigraph_workspace_stats(ws);
+	  fprintf(stderr, "%9s: %3d ~> %3d: scanned %zu vertices, %zu edges in %.3f s\n",
+		  query->method, query->from, query->to, stats.vertices, stats.edges,
+		  (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+	}
+    }
+}
+
+
+void prepare_labels(ldigraph *g, const char *fname, bool timing)
+{
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  char *labels_name = NULL;
+  if (fname != NULL && (labels_name = malloc(strlen(fname) + strlen(".labels") + 1)) != NULL)
+    {
+      strcpy(labels_name, fname);
+      strcat(labels_name, ".labels");
+    }
+  
+  bool loaded = labels_name != NULL && ldigraph_load_labels(g, labels_name);
+  if (!loaded && ldigraph_build_labels(g) && labels_name != NULL)
+    {
+      ldigraph_save_labels(g, labels_name);
+    }
+  free(labels_name);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  if (timing)
+    {
+      fprintf(stderr, "labels: %zu entries %s in %.3f s\n", ldigraph_label_count(g), loaded ? "loaded" : "built",
+	      (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+    }
+}
+
+
+int path_query_compare(const void *a, const void *b)
+{
+  const path_query *q1 = *(const path_query * const *)a;
+  const path_query *q2 = *(const path_query * const *)b;
+
+  int method = strcmp(q1->method, q2->method);
+  if (method != 0)
+    {
+      return method;
+    }
+  else if (q1->from != q2->from)
+    {
+      return q1->from < q2->from ? -1 : 1;
+    }
+  else if (q1->to != q2->to)
+    {
+      return q1->to < q2->to ? -1 : 1;
+    }
+  else
+    {
+      return 0;
+    }
+}
+
+
+bool determine_engine(const char *s, ldigraph_shortest_engine *engine)
+{
+  if (strcmp(s, "auto") == 0)
+    {
+      *engine = LDIGRAPH_SHORTEST_AUTO;
+    }
+  else if (strcmp(s, "bfs") == 0)
+    {
+      *engine = LDIGRAPH_SHORTEST_BFS;
+    }
+  else if (strcmp(s, "bidirectional") == 0)
+    {
+      *engine = LDIGRAPH_SHORTEST_BIDIRECTIONAL;
+    }
+  else if (strcmp(s, "direction") == 0)
+    {
+      *engine = LDIGRAPH_SHORTEST_DIRECTION_OPTIMIZING;
+    }
+  else if (strcmp(s, "alt") == 0)
+    {
+      *engine = LDIGRAPH_SHORTEST_ALT;
+    }
+  else
+    {
+      return false;
+    }
+  return true;
+}
+
+
+bool parse_option_integer(const char *s, unsigned long long *value)
+{
+  // strtoull alone would take "abc" as 0, "5x" as 5, and "-1" as the
+  // largest value
+  if (s == NULL || !isdigit((unsigned char)s[0]))
+    {
+      return false;
+    }
+
+  char *end;
+  errno = 0;
+  *value = strtoull(s, &end, 10);
+  return *end == '\0' && errno != ERANGE;
+}
+
+
+bool parse_option_number(const char *s, double *value)
+{
+  // starting with a digit or a point also rules out a sign, "inf", and
+  // "nan", which strtod would read
+  if (s == NULL || !(isdigit((unsigned char)s[0]) || (s[0] == '.' && isdigit((unsigned char)s[1]))))
+    {
+      return false;
+    }
+
+  char *end;
+  errno = 0;
+  *value = strtod(s, &end);
+  return *end == '\0' && errno != ERANGE;
+}
+
+
+bool determine_generator(const char *s, graph_generator *kind)
+{
+  if (strcmp(s, "sparse") == 0)
+    {
+      *kind = GENERATE_SPARSE;
+    }
+  else if (strcmp(s, "rmat") == 0)
+    {
+      *kind = GENERATE_RMAT;
+    }
+  else if (strcmp(s, "er") == 0)
+    {
+      *kind = GENERATE_ER;
+    }
+  else if (strcmp(s, "grid") == 0)
+    {
+      *kind = GENERATE_GRID;
+    }
+  else if (strcmp(s, "dag") == 0)
+    {
+      *kind = GENERATE_DAG;
+    }
+  else if (strcmp(s, "scc") == 0)
+    {
+      *kind = GENERATE_SCC;
+    }
+  else
+    {
+      return false;
+    }
+  return true;
+}
+
+
+bool determine_reorder(const char *s, ldigraph_reorder_strategy *strategy)
+{
+  if (strcmp(s, "bfs") == 0)
+    {
+      *strategy = LDIGRAPH_REORDER_BFS;
+    }
+  else if (strcmp(s, "rcm") == 0)
+    {
+      *strategy = LDIGRAPH_REORDER_RCM;
+    }
+  else if (strcmp(s, "degree") == 0)
+    {
+      *strategy = LDIGRAPH_REORDER_DEGREE;
+    }
+  else if (strcmp(s, "gorder") == 0)
+    {
+      *strategy = LDIGRAPH_REORDER_GORDER;
+    }
+  else
+    {
+      return false;
+    }
+  return true;
+}
+
+
+void renumber_queries(path_query *queries, size_t count, const ldigraph_vertex *numbers)
+{
+  for (size_t i = 0; i < count; i++)
+    {
+      queries[i].from = numbers[queries[i].from];
+      queries[i].to = numbers[queries[i].to];
+    }
+}
+
+
+ldigraph *create_sparse(size_t size)
+{
+  // make a sparse graph for timing -shortest and -longest on acyclic
+  ldigraph *g = ldigraph_create(size);
+  
+  if (g == NULL)
+    {
+      return NULL;
+    }
+  
+  // main spine of the graph will be 0->2->3->...->size-1->1
+  // with additional edges from the vertices between 2 and size-2
+  
+  // vertex 0 will be the source vertex (1st in topo sort)
   ldigraph_add_edge(g, 0, 2);
   
   // vertex 1 will be the destination vertex (last in topo sort)
@@ -217,3 +1473,214 @@ ldigraph *create_sparse(size_t size)
   
   return g;
 }
+
+
+ldigraph *generate_graph(generator_spec *spec, int threads)
+{
+  if (spec->kind == GENERATE_SPARSE)
+    {
+      return create_sparse(spec->n);
+    }
+
+  spec->side = 1;
+  while (spec->kind == GENERATE_GRID && spec->side * spec->side < spec->n)
+    {
+      spec->side++;
+    }
+  while (spec->kind != GENERATE_GRID && spec->side < spec->n)
+    {
+      spec->side *= 2;
+    }
+
+  size_t m = spec->kind == GENERATE_GRID ? spec->n * 4 : spec->n * spec->degree;
+  size_t blocks = m / GENERATE_BLOCK + 1;
+  size_t pieces = (size_t)threads < blocks ? (size_t)threads : blocks;
+  ldigraph_vertex *from = malloc(sizeof(ldigraph_vertex) * (m > 0 ? m : 1));
+  ldigraph_vertex *to = malloc(sizeof(ldigraph_vertex) * (m > 0 ? m : 1));
+  generator_task *tasks = malloc(sizeof(generator_task) * pieces);
+  pthread_t *ids = malloc(sizeof(pthread_t) * pieces);
+  bool *started = malloc(sizeof(bool) * pieces);
+  ldigraph *g = NULL;
+  if (from != NULL && to != NULL && tasks != NULL && ids != NULL && started != NULL)
+    {
+      // the calling thread takes the first share, and any share that
+      // could not get a thread of its own
+      for (size_t i = 0; i < pieces; i++)
+	{
+	  tasks[i].spec = spec;
+	  tasks[i].from = from;
+	  tasks[i].to = to;
+	  tasks[i].m = m;
+	  tasks[i].first = i;
+	  tasks[i].step = pieces;
+	  started[i] = i > 0 && pthread_create(&ids[i], NULL, generate_edges, &tasks[i]) == 0;
+	}
+      generate_edges(&tasks[0]);
+      for (size_t i = 1; i < pieces; i++)
+	{
+	  if (started[i])
+	    {
+	      pthread_join(ids[i], NULL);
+	    }
+	  else
+	    {
+	      generate_edges(&tasks[i]);
+	    }
+	}
+
+      g = ldigraph_create_from_edges(spec->n, from, to, m);
+    }
+
+  free(from);
+  free(to);
+  free(tasks);
+  free(ids);
+  free(started);
+  return g;
+}
+
+
+void *generate_edges(void *arg)
+{
+  generator_task *task = arg;
+  for (size_t b = task->first; b * GENERATE_BLOCK < task->m; b += task->step)
+    {
+      // a block's stream starts from a scrambled state so that streams of
+      // neighboring blocks do not overlap
+      uint64_t state = task->spec->seed + b * 0x9e3779b97f4a7c15;
+      state = next_random(&state);
+      size_t end = task->m - b * GENERATE_BLOCK > GENERATE_BLOCK ? (b + 1) * GENERATE_BLOCK : task->m;
+      for (size_t e = b * GENERATE_BLOCK; e < end; e++)
+	{
+	  generate_edge(task->spec, e, &state, &task->from[e], &task->to[e]);
+	}
+    }
+
+  return NULL;
+}
+
+
+void generate_edge(const generator_spec *spec, size_t e, uint64_t *state, ldigraph_vertex *from, ldigraph_vertex *to)
+{
+  size_t n = spec->n;
+  size_t v = e / spec->degree;
+  switch (spec->kind)
+    {
+    case GENERATE_RMAT:
+      {
+	// choose a quadrant of the adjacency matrix at each level, starting
+	// over if the edge falls outside the n-by-n corner; each level takes
+	// 16 random bits, and the choice is made without branches because
+	// it is unpredictable
+	const uint64_t a = RMAT_A * 65536;
+	const uint64_t ab = (RMAT_A + RMAT_B) * 65536;
+	const uint64_t abc = (RMAT_A + RMAT_B + RMAT_C) * 65536;
+	size_t u;
+	do
+	  {
+	    v = 0;
+	    u = 0;
+	    uint64_t bits = 0;
+	    int left = 0;
+	    for (size_t bit = spec->side / 2; bit > 0; bit /= 2)
+	      {
+		if (left == 0)
+		  {
+		    bits = next_random(state);
+		    left = 4;
+		  }
+		uint64_t r = bits & 0xffff;
+		bits >>= 16;
+		left--;
+
+		// the second and fourth quadrants are to the right, and the
+		// third and fourth below
+		u += bit * ((r >= a) ^ (r >= ab) ^ (r >= abc));
+		v += bit * (r >= ab);
+	      }
+	  }
+	while (v >= n || u >= n);
+	*from = v;
+	*to = u;
+      }
+      break;
+
+    case GENERATE_ER:
+      *from = next_random(state) % n;
+      *to = next_random(state) % n;
+      break;
+
+    case GENERATE_GRID:
+      {
+	// four edges per vertex: right, left, down, up, where they exist
+	size_t columns = spec->side;
+	v = e / 4;
+	size_t column = v % columns;
+	size_t u = v;
+	switch (e % 4)
+	  {
+	  case 0:
+	    u = column + 1 < columns && v + 1 < n ? v + 1 : v;
+	    break;
+	  case 1:
+	    u = column > 0 ? v - 1 : v;
+	    break;
+	  case 2:
+	    u = v + columns < n ? v + columns : v;
+	    break;
+	  default:
+	    u = v >= columns ? v - columns : v;
+	    break;
+	  }
+	*from = v;
+	*to = u;
+      }
+      break;
+
+    case GENERATE_DAG:
+      {
+	// from layer v / width to either of the next two
+	size_t start = (v / spec->width + 1) * spec->width;
+	*from = v;
+	*to = v;
+	if (start < n)
+	  {
+	    size_t span = n - start < 2 * spec->width ? n - start : 2 * spec->width;
+	    *to = start + next_random(state) % span;
+	  }
+      }
+      break;
+
+    default:
+      {
+	// planted components: the first edge of each vertex makes a cycle
+	// through its component, and the others stay in it or go on to a
+	// later one at random
+	size_t start = v / spec->width * spec->width;
+	size_t size = n - start < spec->width ? n - start : spec->width;
+	*from = v;
+	if (e % spec->degree == 0)
+	  {
+	    *to = start + (v - start + 1) % size;
+	  }
+	else if (start + size < n && next_random(state) % 2 == 0)
+	  {
+	    *to = start + size + next_random(state) % (n - start - size);
+	  }
+	else
+	  {
+	    *to = start + next_random(state) % size;
+	  }
+      }
+      break;
+    }
+}
+
+
+uint64_t next_random(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}